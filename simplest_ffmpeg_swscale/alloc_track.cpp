@@ -0,0 +1,316 @@
+/**
+ * Allocation tracking for the conversion loop
+ *
+ * Build with -DALLOC_TRACK on Linux/glibc to count allocations.
+ * The replacement functions forward to glibc's __libc_* entry points, so
+ * they are picked up by symbol interposition for the shared FFmpeg
+ * libraries as well. The per subsystem counts cost a thread local lookup
+ * per call, and malloc_usable_size() per call inside an AllocScope.
+ */
+
+#include <atomic>
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+extern "C"
+{
+#include "libavutil/mem.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libavutil/mem.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+#include "alloc_track.h"
+
+#if defined(ALLOC_TRACK) && defined(__GLIBC__)
+
+#include <errno.h>
+#include <stdlib.h>
+#include <malloc.h>
+#include <dlfcn.h>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t nmemb, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void *__libc_valloc(size_t size);
+void *__libc_pvalloc(size_t size);
+void __libc_free(void *ptr);
+}
+
+static std::atomic<int64_t> n_allocs(0);
+static std::atomic<int64_t> n_frees(0);
+static std::atomic<int64_t> n_bytes(0);
+static std::atomic<int64_t> n_rejected(0);
+//0: no limit
+static std::atomic<size_t> max_alloc_size(0);
+
+static std::atomic<int64_t> tag_allocs[ALLOC_NB_TAGS];
+static std::atomic<int64_t> tag_bytes[ALLOC_NB_TAGS];
+static std::atomic<int64_t> tag_held[ALLOC_NB_TAGS];
+static std::atomic<int64_t> tag_peak_held[ALLOC_NB_TAGS];
+
+//Subsystem of the calling thread, and while it is in a scope the bytes it
+//has been handed by glibc minus those it gave back; thread_claimed is the
+//part of that already charged by scopes nested in the current ones.
+static thread_local AllocTag thread_tag;
+static thread_local int thread_scope_depth;
+static thread_local int64_t thread_live;
+static thread_local int64_t thread_claimed;
+
+//glibc's malloc_usable_size(), set up by the first scope. Looking it up
+//may allocate, so it cannot be done from the replacement functions.
+static size_t (*libc_usable_size)(void *)=NULL;
+
+static void find_libc_usable_size()
+{
+	if(!libc_usable_size)
+		libc_usable_size=(size_t (*)(void *))dlsym(RTLD_NEXT,"malloc_usable_size");
+}
+
+//Bytes taken by a block, for the scopes of the calling thread
+static int64_t scope_size(void *ptr)
+{
+	if(!thread_scope_depth||!ptr||!libc_usable_size)
+		return 0;
+	return (int64_t)libc_usable_size(ptr);
+}
+
+static int over_limit(size_t size)
+{
+	size_t max=max_alloc_size.load(std::memory_order_relaxed);
+	if(max&&size>max){
+		n_rejected++;
+		return 1;
+	}
+	return 0;
+}
+
+static void *count(void *ptr,size_t size)
+{
+	if(ptr){
+		n_allocs.fetch_add(1,std::memory_order_relaxed);
+		n_bytes.fetch_add(size,std::memory_order_relaxed);
+		tag_allocs[thread_tag].fetch_add(1,std::memory_order_relaxed);
+		tag_bytes[thread_tag].fetch_add(size,std::memory_order_relaxed);
+		thread_live+=scope_size(ptr);
+	}
+	return ptr;
+}
+
+extern "C" {
+
+void *malloc(size_t size) __THROW
+{
+	if(over_limit(size))
+		return NULL;
+	return count(__libc_malloc(size),size);
+}
+
+void *calloc(size_t nmemb, size_t size) __THROW
+{
+	if(size&&nmemb>(size_t)-1/size)
+		return NULL;
+	if(over_limit(nmemb*size))
+		return NULL;
+	return count(__libc_calloc(nmemb,size),nmemb*size);
+}
+
+void *realloc(void *ptr, size_t size) __THROW
+{
+	//glibc frees the block and returns NULL
+	if(ptr&&size==0){
+		free(ptr);
+		return NULL;
+	}
+	if(over_limit(size))
+		return NULL;
+	int64_t old_size=scope_size(ptr);
+	void *ret=__libc_realloc(ptr,size);
+	if(ret)
+		thread_live-=old_size;
+	return count(ret,size);
+}
+
+void free(void *ptr) __THROW
+{
+	if(ptr){
+		n_frees.fetch_add(1,std::memory_order_relaxed);
+		thread_live-=scope_size(ptr);
+	}
+	__libc_free(ptr);
+}
+
+static int is_power_of_2(size_t x)
+{
+	return x&&!(x&(x-1));
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size) __THROW
+{
+	void *ptr;
+	if(!is_power_of_2(alignment)||alignment%sizeof(void *))
+		return EINVAL;
+	if(over_limit(size))
+		return ENOMEM;
+	ptr=count(__libc_memalign(alignment,size),size);
+	if(!ptr)
+		return ENOMEM;
+	*memptr=ptr;
+	return 0;
+}
+
+void *memalign(size_t alignment, size_t size) __THROW
+{
+	if(over_limit(size))
+		return NULL;
+	return count(__libc_memalign(alignment,size),size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) __THROW
+{
+	if(!is_power_of_2(alignment)){
+		errno=EINVAL;
+		return NULL;
+	}
+	if(over_limit(size))
+		return NULL;
+	return count(__libc_memalign(alignment,size),size);
+}
+
+void *valloc(size_t size) __THROW
+{
+	if(over_limit(size))
+		return NULL;
+	return count(__libc_valloc(size),size);
+}
+
+void *pvalloc(size_t size) __THROW
+{
+	if(over_limit(size))
+		return NULL;
+	return count(__libc_pvalloc(size),size);
+}
+
+//Blocks all come from glibc, so its own malloc_usable_size() is right for
+//them; it is only reachable through the next definition of the symbol.
+size_t malloc_usable_size(void *ptr) __THROW
+{
+	if(!ptr)
+		return 0;
+	find_libc_usable_size();
+	return libc_usable_size?libc_usable_size(ptr):0;
+}
+
+}
+
+int alloc_track_enabled()
+{
+	return 1;
+}
+
+void alloc_track_max_alloc(size_t max)
+{
+	av_max_alloc(max);
+	max_alloc_size=max;
+}
+
+void alloc_track_get(AllocStats *stats)
+{
+	stats->allocs=n_allocs.load();
+	stats->frees=n_frees.load();
+	stats->bytes=n_bytes.load();
+	stats->rejected=n_rejected.load();
+}
+
+void alloc_track_get_tag(AllocTag tag,AllocTagStats *stats)
+{
+	stats->allocs=tag_allocs[tag].load();
+	stats->bytes=tag_bytes[tag].load();
+	stats->held=tag_held[tag].load();
+	stats->peak_held=tag_peak_held[tag].load();
+}
+
+AllocScope::AllocScope(AllocTag tag)
+	:tag(tag),prev_tag(thread_tag),start_live(thread_live),start_claimed(thread_claimed)
+{
+	find_libc_usable_size();
+	thread_tag=tag;
+	thread_scope_depth++;
+}
+
+AllocScope::~AllocScope()
+{
+	int64_t held=(thread_live-start_live)-(thread_claimed-start_claimed);
+	thread_claimed+=held;
+	thread_tag=prev_tag;
+	thread_scope_depth--;
+	int64_t now=tag_held[tag].fetch_add(held)+held;
+	int64_t peak=tag_peak_held[tag].load();
+	while(now>peak&&!tag_peak_held[tag].compare_exchange_weak(peak,now))
+		;
+}
+
+#else
+
+int alloc_track_enabled()
+{
+	return 0;
+}
+
+void alloc_track_max_alloc(size_t max)
+{
+	av_max_alloc(max);
+}
+
+void alloc_track_get(AllocStats *stats)
+{
+	stats->allocs=0;
+	stats->frees=0;
+	stats->bytes=0;
+	stats->rejected=0;
+}
+
+void alloc_track_get_tag(AllocTag tag,AllocTagStats *stats)
+{
+	(void)tag;
+	stats->allocs=0;
+	stats->bytes=0;
+	stats->held=0;
+	stats->peak_held=0;
+}
+
+AllocScope::AllocScope(AllocTag tag)
+	:tag(tag),prev_tag(ALLOC_TAG_OTHER),start_live(0),start_claimed(0)
+{
+}
+
+AllocScope::~AllocScope()
+{
+}
+
+#endif
+
+const char *alloc_tag_name(AllocTag tag)
+{
+	static const char *const names[ALLOC_NB_TAGS]={"other","frames","swscale","palette"};
+	return tag>=0&&tag<ALLOC_NB_TAGS?names[tag]:"?";
+}
+
+int64_t alloc_track_allocs_since(const AllocStats *before)
+{
+	AllocStats now;
+	alloc_track_get(&now);
+	return now.allocs-before->allocs;
+}
@@ -0,0 +1,78 @@
+/**
+ * Allocation tracking for the conversion loop
+ *
+ * When built with ALLOC_TRACK defined (Linux/glibc only), alloc_track.cpp
+ * replaces malloc()/free() and friends for the whole process, so every
+ * allocation made by this program, by libavutil (av_malloc() goes through
+ * posix_memalign()) and by libswscale is counted.
+ * Without ALLOC_TRACK the functions below are stubs and
+ * alloc_track_enabled() returns 0.
+ *
+ * Allocations are also charged to the subsystem the calling thread is in,
+ * as set by an AllocScope around its setup and teardown:
+ *
+ *   {
+ *       AllocScope scope(ALLOC_TAG_SWSCALE);
+ *       ctx=sws_getContext(...);
+ *   }
+ *
+ * Inside a scope the bytes glibc hands out and takes back are summed per
+ * thread, so what a scope still holds when it ends (the tables of a new
+ * SwsContext, not the temporaries freed before sws_getContext() returns)
+ * is added to its subsystem. A block allocated in a scope must be freed in
+ * a scope of the same subsystem for its bytes to be taken off again.
+ */
+
+#ifndef ALLOC_TRACK_H
+#define ALLOC_TRACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct AllocStats{
+	int64_t allocs;     //Successful allocations (malloc, calloc, realloc, memalign...)
+	int64_t frees;      //Non-NULL frees
+	int64_t bytes;      //Bytes requested by successful allocations
+	int64_t rejected;   //Requests larger than the limit set by alloc_track_max_alloc()
+}AllocStats;
+
+typedef enum AllocTag{
+	ALLOC_TAG_OTHER=0,      //Outside any scope: stdio buffers, job state, threads
+	ALLOC_TAG_FRAMES,       //Frame planes (frame_buffer_ensure())
+	ALLOC_TAG_SWSCALE,      //SwsContexts and their filters and tables
+	ALLOC_TAG_PALETTE,      //PAL8 quantizers
+	ALLOC_NB_TAGS
+}AllocTag;
+
+typedef struct AllocTagStats{
+	int64_t allocs;     //As in AllocStats
+	int64_t bytes;
+	int64_t held;       //Bytes, as allocated by glibc, held now by scopes of the tag
+	int64_t peak_held;
+}AllocTagStats;
+
+class AllocScope{
+public:
+	explicit AllocScope(AllocTag tag);
+	~AllocScope();
+	AllocScope(const AllocScope &)=delete;
+	AllocScope &operator=(const AllocScope &)=delete;
+
+private:
+	AllocTag tag,prev_tag;
+	int64_t start_live,start_claimed;
+};
+
+int alloc_track_enabled();
+
+//Set the largest single block, for both av_malloc() and the tracked malloc()
+void alloc_track_max_alloc(size_t max);
+
+void alloc_track_get(AllocStats *stats);
+void alloc_track_get_tag(AllocTag tag,AllocTagStats *stats);
+const char *alloc_tag_name(AllocTag tag);
+
+//Allocations between two snapshots
+int64_t alloc_track_allocs_since(const AllocStats *before);
+
+#endif
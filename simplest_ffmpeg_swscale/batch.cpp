@@ -0,0 +1,448 @@
+/**
+ * Batch mode: run many conversions in one process
+ *
+ * Jobs are spread over a thread pool. Every worker keeps its buffers from
+ * job to job and all workers share one SwsContext cache, so a run of small
+ * jobs with the same parameters pays for setup once.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+extern "C"
+{
+#include "libswscale/swscale.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/time.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libswscale/swscale.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/time.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+#include "batch.h"
+#include "frame_io.h"
+#include "pal8_expand.h"
+#include "palette.h"
+#include "sws_cache.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "probes.h"
+
+static const struct{
+	const char *name;
+	int flags;
+}sws_flag_names[]={
+	{"point",         SWS_POINT},
+	{"fast_bilinear", SWS_FAST_BILINEAR},
+	{"bilinear",      SWS_BILINEAR},
+	{"bicubic",       SWS_BICUBIC},
+	{"experimental",  SWS_X},
+	{"area",          SWS_AREA},
+	{"bicublin",      SWS_BICUBLIN},
+	{"gauss",         SWS_GAUSS},
+	{"sinc",          SWS_SINC},
+	{"lanczos",       SWS_LANCZOS},
+	{"spline",        SWS_SPLINE},
+};
+
+int parse_sws_flags(const char *name)
+{
+	for(unsigned i=0;i<sizeof(sws_flag_names)/sizeof(sws_flag_names[0]);i++){
+		if(strcmp(sws_flag_names[i].name,name)==0)
+			return sws_flag_names[i].flags;
+	}
+	return -1;
+}
+
+const char *sws_flags_name(int flags)
+{
+	for(unsigned i=0;i<sizeof(sws_flag_names)/sizeof(sws_flag_names[0]);i++){
+		if(sws_flag_names[i].flags==flags)
+			return sws_flag_names[i].name;
+	}
+	return "unknown";
+}
+
+static int parse_job(const char *line,JobSpec *job)
+{
+	char src_fmt[64],dst_fmt[64],flags[64]="bicubic",dither[64]="";
+	int n=sscanf(line,"%1023s %d %d %63s %1023s %d %d %63s %63s %63s",
+		job->input,&job->src_w,&job->src_h,src_fmt,
+		job->output,&job->dst_w,&job->dst_h,dst_fmt,flags,dither);
+	if(n<8)
+		return -1;
+	job->src_pixfmt=av_get_pix_fmt(src_fmt);
+	job->dst_pixfmt=av_get_pix_fmt(dst_fmt);
+	job->flags=parse_sws_flags(flags);
+	job->dither=strcmp(dither,"dither")==0;
+	if(!is_supported_pixfmt(job->src_pixfmt)&&job->src_pixfmt!=AV_PIX_FMT_PAL8){
+		printf("Not Support Input Pixel Format: %s\n",src_fmt);
+		return -1;
+	}
+	if(!is_supported_pixfmt(job->dst_pixfmt)&&job->dst_pixfmt!=AV_PIX_FMT_PAL8){
+		printf("Not Support Output Pixel Format: %s\n",dst_fmt);
+		return -1;
+	}
+	if(job->flags<0){
+		printf("Unknown scaler: %s\n",flags);
+		return -1;
+	}
+	if(dither[0]&&!job->dither){
+		printf("Unknown option: %s\n",dither);
+		return -1;
+	}
+	if(check_frame_size(job->src_pixfmt,job->src_w,job->src_h)<0||
+		check_frame_size(job->dst_pixfmt,job->dst_w,job->dst_h)<0){
+		printf("Invalid size (must be a multiple of the chroma subsampling)\n");
+		return -1;
+	}
+	return 0;
+}
+
+int read_manifest(const char *path,JobSpec **jobs)
+{
+	FILE *file=fopen(path,"r");
+	char line[4096];
+	int nb_jobs=0,max_jobs=0,line_idx=0;
+	JobSpec *list=NULL;
+
+	if(!file){
+		printf("Could not open manifest %s\n",path);
+		return -1;
+	}
+	while(fgets(line,sizeof(line),file)){
+		char *p=line;
+		line_idx++;
+		while(*p==' '||*p=='\t')
+			p++;
+		if(*p=='#'||*p=='\n'||*p=='\r'||*p=='\0')
+			continue;
+		if(nb_jobs==max_jobs){
+			JobSpec *tmp;
+			max_jobs=max_jobs?max_jobs*2:64;
+			tmp=(JobSpec *)realloc(list,max_jobs*sizeof(JobSpec));
+			if(!tmp){
+				free(list);
+				fclose(file);
+				return -1;
+			}
+			list=tmp;
+		}
+		if(parse_job(p,&list[nb_jobs])<0){
+			printf("Manifest %s line %d: invalid job\n",path,line_idx);
+			free(list);
+			fclose(file);
+			return -1;
+		}
+		//Jobs run concurrently, two of them must not write the same file
+		for(int i=0;i<nb_jobs;i++){
+			if(strcmp(list[i].output,list[nb_jobs].output)==0){
+				printf("Manifest %s line %d: output %s is already written by job %d\n",
+					path,line_idx,list[nb_jobs].output,i);
+				free(list);
+				fclose(file);
+				return -1;
+			}
+		}
+		nb_jobs++;
+	}
+	fclose(file);
+	*jobs=list;
+	return nb_jobs;
+}
+
+int check_no_pal8(const JobSpec *jobs,int nb_jobs)
+{
+	for(int i=0;i<nb_jobs;i++){
+		if(jobs[i].src_pixfmt==AV_PIX_FMT_PAL8||jobs[i].dst_pixfmt==AV_PIX_FMT_PAL8){
+			printf("Job %d: pal8 is only supported in batch mode\n",i);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+typedef struct WorkerState{
+	FrameBuffer src,dst;
+	uint8_t *temp_buffer;
+	int temp_size;
+	uint8_t *indices;       //pal8 output
+	int indices_size;
+}WorkerState;
+
+typedef struct JobResult{
+	int ret;
+	int frames;
+	int64_t bytes_in,bytes_out;
+	int64_t time_us;
+	int64_t palette_rebuilds;
+}JobResult;
+
+typedef struct BatchState{
+	SwsCache *cache;
+	WorkerState *workers;
+}BatchState;
+
+typedef struct BatchTask{
+	BatchState *state;
+	const JobSpec *job;
+	int job_idx;
+	JobResult *result;
+}BatchTask;
+
+//job_idx: track of the job's spans in a trace
+static int process_job(const JobSpec *job,int job_idx,WorkerState *ws,SwsCache *cache,JobResult *res)
+{
+	int pal8_in=job->src_pixfmt==AV_PIX_FMT_PAL8;
+	int pal8=job->dst_pixfmt==AV_PIX_FMT_PAL8;
+	int src_size=pal8_in?pal8_frame_size(job->src_w,job->src_h):
+		raw_frame_size(job->src_pixfmt,job->src_w,job->src_h);
+	//pal8 is expanded to and quantized from rgb24
+	AVPixelFormat src_pixfmt=pal8_in?AV_PIX_FMT_RGB24:job->src_pixfmt;
+	AVPixelFormat scale_pixfmt=pal8?AV_PIX_FMT_RGB24:job->dst_pixfmt;
+	FillPlanesFunc fill=get_fill_planes(src_pixfmt);
+	WritePlanesFunc write=get_write_planes(scale_pixfmt);
+	FILE *src_file,*dst_file;
+	struct SwsContext *img_convert_ctx;
+	PaletteQuantizer *pq=NULL;
+	uint32_t pal[256];
+	SwsCacheKey key;
+	int ret=0;
+
+	if(ws->temp_size<src_size){
+		free(ws->temp_buffer);
+		ws->temp_buffer=(uint8_t *)malloc(src_size);
+		ws->temp_size=ws->temp_buffer?src_size:0;
+		if(!ws->temp_buffer)
+			return -1;
+	}
+	if(frame_buffer_ensure(&ws->src,job->src_w,job->src_h,src_pixfmt)<0||
+		frame_buffer_ensure(&ws->dst,job->dst_w,job->dst_h,scale_pixfmt)<0){
+		printf("Could not allocate image\n");
+		return -1;
+	}
+	if(pal8&&ws->indices_size<job->dst_w*job->dst_h){
+		free(ws->indices);
+		ws->indices=(uint8_t *)malloc(job->dst_w*job->dst_h);
+		ws->indices_size=ws->indices?job->dst_w*job->dst_h:0;
+		if(!ws->indices)
+			return -1;
+	}
+	if(pal8){
+		pq=palette_alloc(job->dither,PALETTE_DEFAULT_DRIFT);
+		if(!pq)
+			return -1;
+	}
+
+	src_file=fopen(job->input,"rb");
+	if(!src_file){
+		printf("Could not open %s\n",job->input);
+		palette_free(&pq);
+		return -1;
+	}
+	dst_file=fopen(job->output,"wb");
+	if(!dst_file){
+		printf("Could not open %s\n",job->output);
+		fclose(src_file);
+		palette_free(&pq);
+		return -1;
+	}
+
+	sws_cache_key_init(&key,job->src_w,job->src_h,src_pixfmt,job->dst_w,job->dst_h,scale_pixfmt);
+	key.flags=job->flags;
+	img_convert_ctx=sws_cache_acquire(cache,&key);
+	if(!img_convert_ctx){
+		printf("Could not initialize context\n");
+		fclose(src_file);
+		fclose(dst_file);
+		palette_free(&pq);
+		return -1;
+	}
+
+	while(1){
+		PROBE_FRAME_START(job_idx,res->frames);
+		int64_t stage_start=trace_now();
+		PROBE_IO_SUBMIT(PROBE_IO_READ);
+		size_t n=fread(ws->temp_buffer,1,src_size,src_file);
+		PROBE_IO_COMPLETE(PROBE_IO_READ,(int64_t)n);
+		if(n!=(size_t)src_size){
+			if(n>0||ferror(src_file)){
+				printf("%s: truncated frame %d\n",job->input,res->frames);
+				ret=-1;
+			}
+			PROBE_FRAME_END(job_idx,res->frames,ret<0?-1:1);
+			break;
+		}
+		if(pal8_in){
+			//The frame's palette follows its indices
+			uint32_t src_pal[256];
+			memcpy(src_pal,ws->temp_buffer+job->src_w*job->src_h,sizeof(src_pal));
+			pal8_expand_rgb24(ws->temp_buffer,job->src_w,src_pal,ws->src.data[0],ws->src.linesize[0],
+				job->src_w,job->src_h);
+		}else{
+			fill(ws->src.data,ws->temp_buffer,job->src_w,job->src_h);
+		}
+		trace_span("read",stage_start,job_idx,res->frames);
+		stage_start=trace_now();
+		PROBE_SCALE_START(img_convert_ctx,job->src_h);
+		sws_scale(img_convert_ctx,ws->src.data,ws->src.linesize,0,job->src_h,ws->dst.data,ws->dst.linesize);
+		PROBE_SCALE_END(img_convert_ctx,job->src_h);
+		trace_span("scale",stage_start,job_idx,res->frames);
+		stage_start=trace_now();
+		if(pal8)
+			palette_quantize(pq,ws->dst.data[0],ws->dst.linesize[0],job->dst_w,job->dst_h,
+				ws->indices,job->dst_w,pal);
+		PROBE_IO_SUBMIT(PROBE_IO_WRITE);
+		if(pal8)
+			ret=fwrite(ws->indices,1,job->dst_w*job->dst_h,dst_file)!=(size_t)(job->dst_w*job->dst_h)||
+				fwrite(pal,4,256,dst_file)!=256?-1:0;
+		else
+			ret=write(dst_file,ws->dst.data,job->dst_w,job->dst_h)<0?-1:0;
+		PROBE_IO_COMPLETE(PROBE_IO_WRITE,ret);
+		if(ret<0){
+			printf("%s: write error\n",job->output);
+			PROBE_FRAME_END(job_idx,res->frames,-1);
+			break;
+		}
+		trace_span("write",stage_start,job_idx,res->frames);
+		PROBE_FRAME_END(job_idx,res->frames,0);
+		res->frames++;
+	}
+	if(ret==0&&res->frames==0){
+		printf("%s: no complete frame\n",job->input);
+		ret=-1;
+	}
+	res->bytes_in=(int64_t)res->frames*src_size;
+	res->bytes_out=(int64_t)res->frames*(raw_frame_size(job->dst_pixfmt,job->dst_w,job->dst_h)+(pal8?1024:0));
+	if(pq){
+		PaletteStats pal_stats;
+		palette_get_stats(pq,&pal_stats);
+		res->palette_rebuilds=pal_stats.rebuilds;
+		palette_free(&pq);
+	}
+
+	sws_cache_release(cache,img_convert_ctx);
+	fclose(src_file);
+	//Buffered data is flushed here, so a full disk may only show now
+	if(fclose(dst_file)!=0){
+		printf("%s: write error\n",job->output);
+		ret=-1;
+	}
+	return ret;
+}
+
+static void run_job(void *arg,int worker_idx)
+{
+	BatchTask *task=(BatchTask *)arg;
+	int64_t start=av_gettime();
+	task->result->ret=process_job(task->job,task->job_idx,&task->state->workers[worker_idx],
+		task->state->cache,task->result);
+	task->result->time_us=av_gettime()-start;
+}
+
+//Frames per second and MB per second (input plus output)
+static void print_throughput(int frames,int64_t bytes,int64_t time_us)
+{
+	double sec=time_us>0?time_us/1000000.0:1e-6;
+	printf("%6d frames %9.3f s %9.1f fps %9.1f MB/s\n",frames,sec,frames/sec,bytes/sec/1000000.0);
+}
+
+int batch_main(const char *manifest,int nb_threads)
+{
+	JobSpec *jobs=NULL;
+	JobResult *results=NULL;
+	BatchTask *tasks=NULL;
+	BatchState state;
+	ThreadPool *pool=NULL;
+	SwsCacheStats cache_stats;
+	int nb_jobs,failed=0,frames=0,ret=-1;
+	int64_t bytes=0,start,time_us;
+
+	state.cache=NULL;
+	state.workers=NULL;
+	nb_jobs=read_manifest(manifest,&jobs);
+	if(nb_jobs<0)
+		return -1;
+
+	pool=thread_pool_alloc(nb_threads);
+	nb_threads=thread_pool_size(pool);
+	//Enough for every worker to keep a few parameter sets warm
+	state.cache=sws_cache_alloc(nb_threads*4);
+	state.workers=(WorkerState *)calloc(nb_threads,sizeof(WorkerState));
+	results=(JobResult *)calloc(nb_jobs>0?nb_jobs:1,sizeof(JobResult));
+	tasks=(BatchTask *)calloc(nb_jobs>0?nb_jobs:1,sizeof(BatchTask));
+	if(!state.cache||!state.workers||!results||!tasks){
+		printf("Could not allocate batch state\n");
+		goto end;
+	}
+	for(int i=0;i<nb_threads;i++){
+		frame_buffer_init(&state.workers[i].src);
+		frame_buffer_init(&state.workers[i].dst);
+	}
+
+	printf("Batch: %d jobs, %d threads\n",nb_jobs,nb_threads);
+	start=av_gettime();
+	for(int i=0;i<nb_jobs;i++){
+		tasks[i].state=&state;
+		tasks[i].job=&jobs[i];
+		tasks[i].job_idx=i;
+		tasks[i].result=&results[i];
+		thread_pool_submit(pool,run_job,&tasks[i]);
+	}
+	thread_pool_wait(pool);
+	time_us=av_gettime()-start;
+
+	for(int i=0;i<nb_jobs;i++){
+		printf("Job %5d %s -> %s: ",i,jobs[i].input,jobs[i].output);
+		if(results[i].ret<0){
+			printf("FAILED\n");
+			failed++;
+			continue;
+		}
+		print_throughput(results[i].frames,results[i].bytes_in+results[i].bytes_out,results[i].time_us);
+		if(jobs[i].dst_pixfmt==AV_PIX_FMT_PAL8)
+			printf("          palette built %lld times for %d frames\n",(long long)results[i].palette_rebuilds,results[i].frames);
+		frames+=results[i].frames;
+		bytes+=results[i].bytes_in+results[i].bytes_out;
+	}
+	sws_cache_get_stats(state.cache,&cache_stats);
+	printf("Total: %d jobs (%d failed) ",nb_jobs,failed);
+	print_throughput(frames,bytes,time_us);
+	printf("SwsContext cache: %lld hits, %lld misses, %lld evictions, hit rate %.1f%%\n",
+		(long long)cache_stats.hits,(long long)cache_stats.misses,(long long)cache_stats.evictions,
+		sws_cache_hit_rate(&cache_stats)*100);
+	ret=failed?1:0;
+
+end:
+	//Joins the workers before their state goes away
+	thread_pool_free(&pool);
+	if(state.workers){
+		for(int i=0;i<nb_threads;i++){
+			frame_buffer_free(&state.workers[i].src);
+			frame_buffer_free(&state.workers[i].dst);
+			free(state.workers[i].temp_buffer);
+			free(state.workers[i].indices);
+		}
+	}
+	free(state.workers);
+	sws_cache_free(&state.cache);
+	free(tasks);
+	free(results);
+	free(jobs);
+	return ret;
+}
@@ -0,0 +1,68 @@
+/**
+ * Batch mode: run many conversions in one process
+ *
+ * A manifest lists one job per line, fields separated by white space:
+ *
+ *   input src_w src_h src_pixfmt output dst_w dst_h dst_pixfmt [flags [dither]]
+ *
+ * e.g. "sintel_480x272_yuv420p.yuv 480 272 yuv420p out.rgb 1280 720 rgb24 bicubic".
+ * Pixel formats use FFmpeg names (see "ffmpeg -pix_fmts"), flags one of
+ * point, fast_bilinear, bilinear, bicubic, area, lanczos... (default bicubic).
+ * Lines starting with '#' are comments.
+ *
+ * Batch mode can also write pal8: frames are scaled to rgb24 and quantized
+ * (see palette.h), "dither" turns on ordered dithering. Each frame is
+ * written as the indices followed by the 256 entry palette (1024 bytes).
+ * pal8 input in the same layout is expanded to rgb24 (see pal8_expand.h).
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+extern "C"
+{
+#include "libavutil/pixfmt.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libavutil/pixfmt.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+#define MAX_PATH_LEN 1024
+
+typedef struct JobSpec{
+	char input[MAX_PATH_LEN];
+	char output[MAX_PATH_LEN];
+	int src_w,src_h;
+	AVPixelFormat src_pixfmt;
+	int dst_w,dst_h;
+	AVPixelFormat dst_pixfmt;
+	int flags;
+	int dither;             //pal8 output only
+}JobSpec;
+
+//SWS_* scaler flag from its name, -1 if unknown
+int parse_sws_flags(const char *name);
+const char *sws_flags_name(int flags);
+
+//Read a manifest into a new array (free() it). Returns the number of jobs, <0 on error.
+int read_manifest(const char *path,JobSpec **jobs);
+
+//0 if no job has pal8 input or output, <0 (with a message) otherwise
+int check_no_pal8(const JobSpec *jobs,int nb_jobs);
+
+//nb_threads<=0: one worker per CPU core
+int batch_main(const char *manifest,int nb_threads);
+
+#endif
@@ -0,0 +1,254 @@
+/**
+ * Cache cliff sweep
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+#include <windows.h>
+extern "C"
+{
+#include "libavutil/imgutils.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/time.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/time.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+#include "cache_sweep.h"
+#include "pattern_source.h"
+#include "batch.h"
+
+//Output pixels per timed run, and runs per point (the fastest counts)
+#define SWEEP_PIXELS 16000000
+#define SWEEP_RUNS 3
+#define SWEEP_BAR_WIDTH 50
+
+static const char *const cache_names[3]={"L1d","L2","L3"};
+
+#ifdef __linux__
+//"48K", "2048K", "32M"
+static int parse_cache_size(const char *str)
+{
+	char unit=0;
+	int size=0;
+	if(sscanf(str,"%d%c",&size,&unit)<1)
+		return 0;
+	if(unit=='K')
+		size*=1024;
+	else if(unit=='M')
+		size*=1024*1024;
+	return size;
+}
+#endif
+
+void detect_cache_sizes(int sizes[3])
+{
+	sizes[0]=sizes[1]=sizes[2]=0;
+#if defined(__linux__)
+	for(int i=0;;i++){
+		char path[128],type[32],size[32];
+		int level=0;
+		FILE *fp;
+		snprintf(path,sizeof(path),"/sys/devices/system/cpu/cpu0/cache/index%d/level",i);
+		if(!(fp=fopen(path,"r")))
+			break;
+		if(fscanf(fp,"%d",&level)!=1)
+			level=0;
+		fclose(fp);
+		snprintf(path,sizeof(path),"/sys/devices/system/cpu/cpu0/cache/index%d/type",i);
+		if(!(fp=fopen(path,"r")))
+			break;
+		if(fscanf(fp,"%31s",type)!=1)
+			type[0]=0;
+		fclose(fp);
+		snprintf(path,sizeof(path),"/sys/devices/system/cpu/cpu0/cache/index%d/size",i);
+		if(!(fp=fopen(path,"r")))
+			break;
+		if(fscanf(fp,"%31s",size)!=1)
+			size[0]=0;
+		fclose(fp);
+		//Instruction caches do not hold pixels
+		if(level>=1&&level<=3&&strcmp(type,"Instruction")!=0)
+			sizes[level-1]=parse_cache_size(size);
+	}
+#elif defined(_WIN32)
+	SYSTEM_LOGICAL_PROCESSOR_INFORMATION *info=NULL;
+	DWORD len=0;
+	GetLogicalProcessorInformation(NULL,&len);
+	info=(SYSTEM_LOGICAL_PROCESSOR_INFORMATION *)malloc(len);
+	if(info&&GetLogicalProcessorInformation(info,&len)){
+		for(DWORD i=0;i<len/sizeof(*info);i++){
+			const CACHE_DESCRIPTOR &c=info[i].Cache;
+			if(info[i].Relationship==RelationCache&&c.Level>=1&&c.Level<=3&&c.Type!=CacheInstruction)
+				sizes[c.Level-1]=c.Size;
+		}
+	}
+	free(info);
+#endif
+}
+
+//Lines of the vertical filter when not downscaling
+static int filter_taps(int flags)
+{
+	if(flags&SWS_POINT)
+		return 1;
+	if(flags&(SWS_FAST_BILINEAR|SWS_BILINEAR|SWS_AREA))
+		return 2;
+	if(flags&SWS_LANCZOS)
+		return 6;
+	return 4;
+}
+
+static int row_bytes(AVPixelFormat pixfmt,int w)
+{
+	int linesize[4];
+	int bytes=0;
+	if(av_image_fill_linesizes(linesize,pixfmt,w)<0)
+		return -1;
+	for(int p=0;p<4;p++)
+		bytes+=linesize[p];
+	return bytes;
+}
+
+//Round down to a width every plane can take
+static int align_width(AVPixelFormat pixfmt,int w)
+{
+	const AVPixFmtDescriptor *desc=av_pix_fmt_desc_get(pixfmt);
+	int align=1<<desc->log2_chroma_w;
+	w=w/align*align;
+	return w>align?w:align;
+}
+
+int cache_sweep(AVPixelFormat src_pixfmt,AVPixelFormat dst_pixfmt,int flags,double dst_ratio,
+				int min_w,int max_w,int step,const char *csv)
+{
+	const AVPixFmtDescriptor *dst_desc=av_pix_fmt_desc_get(dst_pixfmt);
+	int caches[3];
+	int nb_points,next_cache=0;
+	double *ns=NULL,max_ns=0;
+	int *working_set=NULL,*src_ws=NULL,*dst_ws=NULL;
+	int src_h=SWEEP_HEIGHT,dst_h=(int)(SWEEP_HEIGHT*dst_ratio+0.5)&~1;
+	int taps=(int)(filter_taps(flags)*(dst_ratio<1?1/dst_ratio:1)+0.5);
+	PatternSpec spec;
+	FILE *fp=NULL;
+	int ret=-1;
+
+	if(!av_pix_fmt_desc_get(src_pixfmt)||!dst_desc||min_w<=0||max_w<min_w||step<=0||dst_ratio<=0||dst_h<2){
+		printf("Invalid sweep parameters\n");
+		return -1;
+	}
+	nb_points=(max_w-min_w)/step+1;
+	ns=(double *)malloc(nb_points*sizeof(double));
+	working_set=(int *)malloc(nb_points*sizeof(int));
+	src_ws=(int *)malloc(nb_points*sizeof(int));
+	dst_ws=(int *)malloc(nb_points*sizeof(int));
+	if(!ns||!working_set||!src_ws||!dst_ws){
+		printf("Could not allocate sweep results\n");
+		goto end;
+	}
+	if(csv&&!(fp=fopen(csv,"w"))){
+		printf("Could not open %s\n",csv);
+		goto end;
+	}
+	detect_cache_sizes(caches);
+	pattern_preset(&spec,"movingbars");
+
+	printf("Cache sweep: %s -> %s %s, destination %.3gx, widths %d to %d step %d, %d rows\n",
+		av_get_pix_fmt_name(src_pixfmt),av_get_pix_fmt_name(dst_pixfmt),sws_flags_name(flags),
+		dst_ratio,min_w,max_w,step,SWEEP_HEIGHT);
+	printf("Caches:");
+	for(int c=0;c<3;c++){
+		if(caches[c])
+			printf(" %s %d KB",cache_names[c],caches[c]/1024);
+	}
+	printf("%s\n",caches[0]||caches[1]||caches[2]?"":" unknown");
+
+	for(int i=0;i<nb_points;i++){
+		int src_w=align_width(src_pixfmt,min_w+i*step);
+		int dst_w=align_width(dst_pixfmt,(int)(src_w*dst_ratio+0.5));
+		int64_t pixels=(int64_t)dst_w*dst_h,best=-1;
+		int reps=(int)(SWEEP_PIXELS/pixels)+1;
+		PatternSource source;
+		Scaler scaler;
+		Frame dst;
+
+		if(source.open(spec,src_w,src_h,src_pixfmt,2,0)<0||dst.alloc(dst_w,dst_h,dst_pixfmt)<0||
+			scaler.init(src_w,src_h,src_pixfmt,dst_w,dst_h,dst_pixfmt,flags)<0||
+			scaler.scale(source.cached(0),dst)<0){
+			printf("Could not convert %dx%d -> %dx%d\n",src_w,src_h,dst_w,dst_h);
+			goto end;
+		}
+		for(int r=0;r<SWEEP_RUNS;r++){
+			int64_t start=av_gettime(),time_us;
+			for(int k=0;k<reps;k++)
+				scaler.scale(source.cached(k),dst);
+			time_us=av_gettime()-start;
+			if(best<0||time_us<best)
+				best=time_us;
+		}
+		src_ws[i]=src_w;
+		dst_ws[i]=dst_w;
+		working_set[i]=row_bytes(src_pixfmt,src_w)+row_bytes(dst_pixfmt,dst_w)+
+			taps*dst_w*2*dst_desc->nb_components;
+		ns[i]=best*1000.0/(pixels*reps);
+		if(ns[i]>max_ns)
+			max_ns=ns[i];
+	}
+
+	printf("  src_w  dst_w  row KB  ns/pixel\n");
+	for(int i=0;i<nb_points;i++){
+		int bar=max_ns>0?(int)(ns[i]/max_ns*SWEEP_BAR_WIDTH+0.5):0;
+		//A line where the row's working set stops fitting
+		while(next_cache<3&&(!caches[next_cache]||working_set[i]>caches[next_cache])){
+			if(caches[next_cache])
+				printf("  ----------------------------- row working set > %s (%d KB)\n",
+					cache_names[next_cache],caches[next_cache]/1024);
+			next_cache++;
+		}
+		printf("  %5d  %5d %7.1f %9.3f |",src_ws[i],dst_ws[i],working_set[i]/1024.0,ns[i]);
+		for(int b=0;b<bar;b++)
+			putchar('#');
+		putchar('\n');
+	}
+	if(fp){
+		fprintf(fp,"# %s -> %s %s, destination %.3gx, %d rows\n",av_get_pix_fmt_name(src_pixfmt),
+			av_get_pix_fmt_name(dst_pixfmt),sws_flags_name(flags),dst_ratio,SWEEP_HEIGHT);
+		for(int c=0;c<3;c++)
+			fprintf(fp,"# %s %d\n",cache_names[c],caches[c]);
+		fprintf(fp,"src_w,dst_w,working_set,ns_per_pixel\n");
+		for(int i=0;i<nb_points;i++)
+			fprintf(fp,"%d,%d,%d,%.4f\n",src_ws[i],dst_ws[i],working_set[i],ns[i]);
+		if(ferror(fp)){
+			printf("Could not write %s\n",csv);
+			goto end;
+		}
+		printf("Points written to %s\n",csv);
+	}
+	ret=0;
+
+end:
+	if(fp)
+		fclose(fp);
+	free(ns);
+	free(working_set);
+	free(src_ws);
+	free(dst_ws);
+	return ret;
+}
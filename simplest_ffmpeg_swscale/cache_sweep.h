@@ -0,0 +1,52 @@
+/**
+ * Cache cliff sweep
+ *
+ * Times one conversion over a fine range of widths and prints ns per
+ * output pixel next to the working set of a row: the source and
+ * destination rows plus the lines the vertical filter keeps (taps lines
+ * of 16-bit samples per component, more taps when downscaling). The
+ * working set is an estimate, not what libswscale allocates exactly, but
+ * it grows the same way, so the steps in the curve line up with the
+ * L1d / L2 / L3 sizes detected on the machine. Those are the sizes to keep
+ * strips or bands of a banded conversion under.
+ *
+ * Frames are generated in RAM (see pattern_source.h) and are only
+ * SWEEP_HEIGHT rows high, so each point runs quickly and the source stays
+ * in cache only when a row's working set does.
+ */
+
+#ifndef CACHE_SWEEP_H
+#define CACHE_SWEEP_H
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+extern "C"
+{
+#include "libavutil/pixfmt.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libavutil/pixfmt.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+#define SWEEP_HEIGHT 64
+
+//Data cache sizes in bytes, 0 where unknown. sizes[0] is L1d.
+void detect_cache_sizes(int sizes[3]);
+
+//Convert widths min_w, min_w+step... max_w of src_pixfmt to dst_pixfmt,
+//the destination dst_ratio times the source in both directions. Also
+//writes the points to csv (gnuplot-friendly) if not NULL.
+int cache_sweep(AVPixelFormat src_pixfmt,AVPixelFormat dst_pixfmt,int flags,double dst_ratio,
+				int min_w,int max_w,int step,const char *csv);
+
+#endif
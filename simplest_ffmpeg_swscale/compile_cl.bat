@@ -1,9 +1,9 @@
-::VS2010 Environment
-call "D:\Program Files\Microsoft Visual Studio 10.0\VC\vcvarsall.bat"
+::VS2015 Environment (C++11 threads and atomics)
+call "D:\Program Files\Microsoft Visual Studio 14.0\VC\vcvarsall.bat"
 ::include
 @set INCLUDE=include;%INCLUDE%
 ::lib
 @set LIB=lib;%LIB%
 ::compile and link
-cl simplest_ffmpeg_swscale.cpp /link swscale.lib avutil.lib /OPT:NOREF
+cl simplest_ffmpeg_swscale.cpp alloc_track.cpp sws_cache.cpp frame_io.cpp thread_pool.cpp batch.cpp stream_sched.cpp realtime.cpp scale_daemon.cpp scaler.cpp palette.cpp pal8_expand.cpp verify.cpp pattern_source.cpp thread_bench.cpp cache_sweep.cpp perf_counters.cpp trace.cpp mem_report.cpp regress.cpp ..\simplest_pic_gen\pattern.c ..\simplest_pic_gen\pattern_manifest.c /link swscale.lib avutil.lib /OPT:NOREF
 exit
@@ -1,3 +1,3 @@
 #! /bin/sh
-g++ simplest_ffmpeg_swscale.cpp -g -o simplest_ffmpeg_swscale.exe \
--I /usr/local/include -L /usr/local/lib -lswscale -lavutil
+g++ simplest_ffmpeg_swscale.cpp alloc_track.cpp sws_cache.cpp frame_io.cpp thread_pool.cpp batch.cpp stream_sched.cpp realtime.cpp scale_daemon.cpp scaler.cpp palette.cpp pal8_expand.cpp verify.cpp pattern_source.cpp thread_bench.cpp cache_sweep.cpp perf_counters.cpp trace.cpp mem_report.cpp regress.cpp ../simplest_pic_gen/pattern.c ../simplest_pic_gen/pattern_manifest.c -g -o simplest_ffmpeg_swscale.exe \
+-I /usr/local/include -L /usr/local/lib -lswscale -lavutil -pthread
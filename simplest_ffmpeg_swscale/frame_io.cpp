@@ -0,0 +1,189 @@
+/**
+ * Raw frame I/O shared by the converter modes
+ */
+
+#include <string.h>
+#include <atomic>
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+extern "C"
+{
+#include "libavutil/imgutils.h"
+#include "libavutil/pixdesc.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+#include "frame_io.h"
+#include "pixfmt_traits.h"
+#include "alloc_track.h"
+
+const AVPixelFormat supported_pixfmts[]={
+	AV_PIX_FMT_GRAY8,
+	AV_PIX_FMT_YUV420P,
+	AV_PIX_FMT_YUV422P,
+	AV_PIX_FMT_YUV444P,
+	AV_PIX_FMT_YUYV422,
+	AV_PIX_FMT_RGB24
+};
+const int nb_supported_pixfmts=sizeof(supported_pixfmts)/sizeof(supported_pixfmts[0]);
+
+int is_supported_pixfmt(AVPixelFormat pixfmt)
+{
+	for(int i=0;i<nb_supported_pixfmts;i++){
+		if(supported_pixfmts[i]==pixfmt)
+			return 1;
+	}
+	return 0;
+}
+
+int check_frame_size(AVPixelFormat pixfmt,int w,int h)
+{
+	const AVPixFmtDescriptor *desc=av_pix_fmt_desc_get(pixfmt);
+	if(!desc||w<=0||h<=0)
+		return -1;
+	//Chroma planes are assumed to be exactly w>>log2_chroma_w wide
+	if(w&((1<<desc->log2_chroma_w)-1)||h&((1<<desc->log2_chroma_h)-1))
+		return -1;
+	return 0;
+}
+
+int raw_frame_size(AVPixelFormat pixfmt,int w,int h)
+{
+	return w*h*av_get_bits_per_pixel(av_pix_fmt_desc_get(pixfmt))/8;
+}
+
+//Copy one frame of raw pixel data into planes
+template<class T> static void fill_planes_fmt(uint8_t *const data[4],const uint8_t *buffer,int w,int h)
+{
+	for(int p=0;p<T::nb_planes;p++){
+		int size=plane_size<T>(p,w,h);
+		memcpy(data[p],buffer,size);
+		buffer+=size;
+	}
+}
+
+//Write planes as one frame of raw pixel data
+template<class T> static int write_planes_fmt(FILE *file,uint8_t *const data[4],int w,int h)
+{
+	size_t written=0;
+	for(int p=0;p<T::nb_planes;p++)
+		written+=fwrite(data[p],1,plane_size<T>(p,w,h),file);
+	//Short write: disk full, I/O error...
+	if(written!=(size_t)frame_size<T>(w,h))
+		return -1;
+	return 0;
+}
+
+#define PIXFMT_FUNCS(fmt) {fmt,fill_planes_fmt<PixFmtTraits<fmt> >,write_planes_fmt<PixFmtTraits<fmt> >}
+
+static const struct{
+	AVPixelFormat pixfmt;
+	FillPlanesFunc fill;
+	WritePlanesFunc write;
+}pixfmt_funcs[]={
+	PIXFMT_FUNCS(AV_PIX_FMT_GRAY8),
+	PIXFMT_FUNCS(AV_PIX_FMT_YUV420P),
+	PIXFMT_FUNCS(AV_PIX_FMT_YUV422P),
+	PIXFMT_FUNCS(AV_PIX_FMT_YUV444P),
+	PIXFMT_FUNCS(AV_PIX_FMT_YUYV422),
+	PIXFMT_FUNCS(AV_PIX_FMT_RGB24),
+};
+
+FillPlanesFunc get_fill_planes(AVPixelFormat pixfmt)
+{
+	for(unsigned i=0;i<sizeof(pixfmt_funcs)/sizeof(pixfmt_funcs[0]);i++){
+		if(pixfmt_funcs[i].pixfmt==pixfmt)
+			return pixfmt_funcs[i].fill;
+	}
+	return NULL;
+}
+
+WritePlanesFunc get_write_planes(AVPixelFormat pixfmt)
+{
+	for(unsigned i=0;i<sizeof(pixfmt_funcs)/sizeof(pixfmt_funcs[0]);i++){
+		if(pixfmt_funcs[i].pixfmt==pixfmt)
+			return pixfmt_funcs[i].write;
+	}
+	return NULL;
+}
+
+int fill_planes(uint8_t *const data[4],const uint8_t *buffer,AVPixelFormat pixfmt,int w,int h)
+{
+	FillPlanesFunc fill=get_fill_planes(pixfmt);
+	if(!fill){
+		printf("Not Support Input Pixel Format.\n");
+		return -1;
+	}
+	fill(data,buffer,w,h);
+	return 0;
+}
+
+int write_planes(FILE *file,uint8_t *const data[4],AVPixelFormat pixfmt,int w,int h)
+{
+	WritePlanesFunc write=get_write_planes(pixfmt);
+	if(!write){
+		printf("Not Support Output Pixel Format.\n");
+		return -1;
+	}
+	return write(file,data,w,h);
+}
+
+void frame_buffer_init(FrameBuffer *buf)
+{
+	memset(buf,0,sizeof(*buf));
+	buf->pixfmt=AV_PIX_FMT_NONE;
+}
+
+static std::atomic<int64_t> frame_bytes(0);
+static std::atomic<int64_t> frame_peak_bytes(0);
+
+int frame_buffer_ensure(FrameBuffer *buf,int w,int h,AVPixelFormat pixfmt)
+{
+	if(buf->data[0]&&buf->w==w&&buf->h==h&&buf->pixfmt==pixfmt)
+		return 0;
+	frame_buffer_free(buf);
+	AllocScope scope(ALLOC_TAG_FRAMES);
+	int size=av_image_alloc(buf->data,buf->linesize,w,h,pixfmt,1);
+	if(size<0)
+		return -1;
+	buf->w=w;
+	buf->h=h;
+	buf->pixfmt=pixfmt;
+	buf->size=size;
+	int64_t now=frame_bytes.fetch_add(size)+size;
+	int64_t peak=frame_peak_bytes.load();
+	while(now>peak&&!frame_peak_bytes.compare_exchange_weak(peak,now))
+		;
+	return 0;
+}
+
+void frame_buffer_free(FrameBuffer *buf)
+{
+	if(buf->data[0]){
+		AllocScope scope(ALLOC_TAG_FRAMES);
+		frame_bytes-=buf->size;
+		av_freep(&buf->data[0]);
+	}
+	frame_buffer_init(buf);
+}
+
+int64_t frame_buffer_bytes_held(int64_t *peak)
+{
+	if(peak)
+		*peak=frame_peak_bytes.load();
+	return frame_bytes.load();
+}
@@ -0,0 +1,76 @@
+/**
+ * Raw frame I/O shared by the converter modes
+ *
+ * Raw files hold frames back to back, each plane written without padding
+ * (linesize equal to width), as produced and consumed by main().
+ */
+
+#ifndef FRAME_IO_H
+#define FRAME_IO_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+extern "C"
+{
+#include "libavutil/pixfmt.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libavutil/pixfmt.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+//Pixel formats supported by fill_planes() and write_planes()
+extern const AVPixelFormat supported_pixfmts[];
+extern const int nb_supported_pixfmts;
+
+int is_supported_pixfmt(AVPixelFormat pixfmt);
+
+//0 if w and h are positive and multiples of the chroma subsampling, as
+//fill_planes() and write_planes() require; <0 otherwise
+int check_frame_size(AVPixelFormat pixfmt,int w,int h);
+
+//Size of one frame in a raw file
+int raw_frame_size(AVPixelFormat pixfmt,int w,int h);
+
+//Copy one frame of raw pixel data into planes
+int fill_planes(uint8_t *const data[4],const uint8_t *buffer,AVPixelFormat pixfmt,int w,int h);
+//Write planes as one frame of raw pixel data, <0 on a short write
+int write_planes(FILE *file,uint8_t *const data[4],AVPixelFormat pixfmt,int w,int h);
+
+//The same, instantiated per format (see pixfmt_traits.h). Look them up once
+//per job instead of dispatching on the format every frame. NULL if the
+//format is not supported.
+typedef void (*FillPlanesFunc)(uint8_t *const data[4],const uint8_t *buffer,int w,int h);
+typedef int (*WritePlanesFunc)(FILE *file,uint8_t *const data[4],int w,int h);
+FillPlanesFunc get_fill_planes(AVPixelFormat pixfmt);
+WritePlanesFunc get_write_planes(AVPixelFormat pixfmt);
+
+//Planes that are reallocated only when size or format changes
+typedef struct FrameBuffer{
+	uint8_t *data[4];
+	int linesize[4];
+	int w,h;
+	AVPixelFormat pixfmt;
+	int size;               //Bytes allocated, with the palette of PAL8 and pseudo-paletted formats
+}FrameBuffer;
+
+void frame_buffer_init(FrameBuffer *buf);
+int frame_buffer_ensure(FrameBuffer *buf,int w,int h,AVPixelFormat pixfmt);
+void frame_buffer_free(FrameBuffer *buf);
+
+//Bytes of all frame planes allocated now, and the most there ever were
+int64_t frame_buffer_bytes_held(int64_t *peak);
+
+#endif
@@ -0,0 +1,193 @@
+/**
+ * Memory footprint report
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+//GetProcessMemoryInfo() from kernel32, no psapi.lib needed
+#define PSAPI_VERSION 2
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <signal.h>
+#include <pthread.h>
+#include <malloc.h>
+#include <thread>
+#endif
+
+#include "mem_report.h"
+#include "alloc_track.h"
+#include "frame_io.h"
+
+int64_t mem_current_rss(void)
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS pmc;
+	if(!GetProcessMemoryInfo(GetCurrentProcess(),&pmc,sizeof(pmc)))
+		return -1;
+	return (int64_t)pmc.WorkingSetSize;
+#elif defined(__linux__)
+	//Second field: resident pages
+	long long size,resident;
+	FILE *fp=fopen("/proc/self/statm","r");
+	if(!fp)
+		return -1;
+	int n=fscanf(fp,"%lld %lld",&size,&resident);
+	fclose(fp);
+	if(n!=2)
+		return -1;
+	return (int64_t)resident*sysconf(_SC_PAGESIZE);
+#else
+	return -1;
+#endif
+}
+
+int64_t mem_peak_rss(void)
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if(!GetProcessMemoryInfo(GetCurrentProcess(),&pmc,sizeof(pmc)))
+		return -1;
+	return (int64_t)pmc.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF,&usage)<0)
+		return -1;
+#ifdef __APPLE__
+	return (int64_t)usage.ru_maxrss;
+#else
+	//In KiB
+	return (int64_t)usage.ru_maxrss*1024;
+#endif
+#endif
+}
+
+int64_t mem_rss_high_water(void)
+{
+#ifdef __linux__
+	char line[256];
+	long long kib=-1;
+	FILE *fp=fopen("/proc/self/status","r");
+	if(!fp)
+		return -1;
+	while(fgets(line,sizeof(line),fp)){
+		if(sscanf(line,"VmHWM: %lld",&kib)==1)
+			break;
+	}
+	fclose(fp);
+	return kib<0?-1:(int64_t)kib*1024;
+#else
+	return -1;
+#endif
+}
+
+int mem_reset_rss_high_water(void)
+{
+#ifdef __linux__
+	malloc_trim(0);
+	//"5" resets the high-water mark to the current size (Linux 4.0)
+	FILE *fp=fopen("/proc/self/clear_refs","w");
+	if(!fp)
+		return -1;
+	int ok=fputs("5",fp)>=0;
+	if(fclose(fp)!=0||!ok)
+		return -1;
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+//MiB in a column of width, "n/a" if not known
+static void print_mib(int64_t bytes,int width)
+{
+	if(bytes<0)
+		printf(" %*s",width,"n/a");
+	else
+		printf(" %*.1f",width,bytes/(1024.0*1024.0));
+}
+
+void mem_report_print(void)
+{
+	int64_t frame_peak;
+	int64_t frame_bytes=frame_buffer_bytes_held(&frame_peak);
+	int tracked=alloc_track_enabled();
+	AllocTagStats sws;
+	alloc_track_get_tag(ALLOC_TAG_SWSCALE,&sws);
+
+	int64_t rss=mem_current_rss(),peak_rss=mem_peak_rss();
+	//The peak is updated by the kernel a little later than the current size
+	if(peak_rss>=0&&rss>peak_rss)
+		peak_rss=rss;
+
+	printf("Memory (MiB)            now      peak\n");
+	printf("resident set      ");
+	print_mib(rss,9);
+	print_mib(peak_rss,9);
+	printf("\nframe buffers     ");
+	print_mib(frame_bytes,9);
+	print_mib(frame_peak,9);
+	printf("\nSwsContext internals");
+	print_mib(tracked?sws.held:-1,7);
+	print_mib(tracked?sws.peak_held:-1,9);
+	printf("\n");
+	if(!tracked){
+		printf("Allocations by subsystem: n/a, build with -DALLOC_TRACK\n");
+		return;
+	}
+	printf("subsystem   allocations  MiB allocated  MiB held  MiB peak\n");
+	for(int t=0;t<ALLOC_NB_TAGS;t++){
+		AllocTagStats st;
+		alloc_track_get_tag((AllocTag)t,&st);
+		printf("%-10s %12lld",alloc_tag_name((AllocTag)t),(long long)st.allocs);
+		print_mib(st.bytes,14);
+		//Nothing outside a scope is followed to its free()
+		print_mib(t==ALLOC_TAG_OTHER?-1:st.held,9);
+		print_mib(t==ALLOC_TAG_OTHER?-1:st.peak_held,9);
+		printf("\n");
+	}
+}
+
+static void report_at_exit(void)
+{
+	mem_report_print();
+	fflush(stdout);
+}
+
+#ifdef __linux__
+static void report_on_signal(sigset_t set)
+{
+	int sig;
+	while(sigwait(&set,&sig)==0){
+		mem_report_print();
+		fflush(stdout);
+	}
+}
+#endif
+
+int mem_report_install(void)
+{
+	if(atexit(report_at_exit)!=0){
+		printf("Could not install the memory report\n");
+		return -1;
+	}
+#ifdef __linux__
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set,SIGUSR1);
+	if(pthread_sigmask(SIG_BLOCK,&set,NULL)!=0){
+		printf("Could not block SIGUSR1, memory report at exit only\n");
+		return 0;
+	}
+	std::thread(report_on_signal,set).detach();
+#endif
+	return 0;
+}
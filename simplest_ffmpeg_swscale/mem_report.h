@@ -0,0 +1,39 @@
+/**
+ * Memory footprint report
+ *
+ * Peak and current resident set size, the bytes held in frame planes and
+ * in SwsContext internals, and the allocations of each subsystem (see
+ * alloc_track.h), so that a container can be given a memory limit from a
+ * run at its resolutions instead of by trial and error:
+ *
+ *   simplest_ffmpeg_swscale -memreport -batch manifest.txt
+ *   kill -USR1 PID          (report of a running process, Linux)
+ *
+ * Frame planes are always counted. SwsContext internals and the subsystem
+ * table need a build with -DALLOC_TRACK, and are shown as n/a otherwise.
+ */
+
+#ifndef MEM_REPORT_H
+#define MEM_REPORT_H
+
+#include <stdint.h>
+
+//Resident set size of the process in bytes, -1 if not known
+int64_t mem_current_rss(void);
+int64_t mem_peak_rss(void);
+
+//High-water mark of the resident set since the last reset (VmHWM), which
+//unlike mem_peak_rss() can be restarted to measure one part of a run.
+//Linux only: -1 elsewhere. The reset first gives free heap memory back to
+//the system (malloc_trim()), so that what the part allocates is seen.
+int64_t mem_rss_high_water(void);
+int mem_reset_rss_high_water(void);
+
+void mem_report_print(void);
+
+//Print the report at exit and on every SIGUSR1 (Linux). Call before any
+//thread is started: SIGUSR1 is blocked for all threads but the one that
+//waits for it.
+int mem_report_install(void);
+
+#endif
@@ -0,0 +1,166 @@
+/**
+ * PAL8 input: expand indexed frames for the scaler
+ *
+ * The SSSE3 kernel loads four palette entries per step and packs their
+ * R, G and B bytes into 12 output bytes with one byte shuffle. It is
+ * compiled for SSSE3 on its own and picked at run time, so the rest of the
+ * program keeps the default instruction set.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+extern "C"
+{
+#include "libswscale/swscale.h"
+#include "libavutil/time.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libswscale/swscale.h>
+#include <libavutil/time.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+#include "pal8_expand.h"
+
+#if defined(__GNUC__)&&(defined(__x86_64__)||defined(__i386__))
+#define PAL8_SSSE3 1
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#include <tmmintrin.h>
+static int cpu_has_ssse3()
+{
+	return __builtin_cpu_supports("ssse3");
+}
+#elif defined(_MSC_VER)&&(defined(_M_X64)||defined(_M_IX86))
+#define PAL8_SSSE3 1
+#define TARGET_SSSE3
+#include <intrin.h>
+#include <tmmintrin.h>
+static int cpu_has_ssse3()
+{
+	int info[4];
+	__cpuid(info,1);
+	return (info[2]>>9)&1;
+}
+#endif
+
+int pal8_frame_size(int w,int h)
+{
+	return w*h+256*4;
+}
+
+static void expand_row_c(const uint8_t *src,const uint32_t *pal,uint8_t *dst,int x,int w)
+{
+	for(;x<w;x++){
+		uint32_t c=pal[src[x]];
+		dst[3*x]=(uint8_t)(c>>16);
+		dst[3*x+1]=(uint8_t)(c>>8);
+		dst[3*x+2]=(uint8_t)c;
+	}
+}
+
+#ifdef PAL8_SSSE3
+TARGET_SSSE3 static void expand_ssse3(const uint8_t *src,int src_linesize,const uint32_t *pal,
+									  uint8_t *dst,int dst_linesize,int w,int h)
+{
+	//Entries are B,G,R,A in memory: gather R,G,B of four pixels into 12 bytes
+	const __m128i shuf=_mm_setr_epi8(2,1,0,6,5,4,10,9,8,14,13,12,-1,-1,-1,-1);
+	for(int y=0;y<h;y++){
+		const uint8_t *s=src+y*src_linesize;
+		uint8_t *d=dst+y*dst_linesize;
+		int x=0;
+		//Each store writes 16 bytes for 12, keep the last 4 inside the row
+		for(;x+6<=w;x+=4){
+			__m128i v=_mm_setr_epi32(pal[s[x]],pal[s[x+1]],pal[s[x+2]],pal[s[x+3]]);
+			_mm_storeu_si128((__m128i *)(d+3*x),_mm_shuffle_epi8(v,shuf));
+		}
+		expand_row_c(s,pal,d,x,w);
+	}
+}
+#endif
+
+void pal8_expand_rgb24(const uint8_t *src,int src_linesize,const uint32_t pal[256],
+					   uint8_t *dst,int dst_linesize,int w,int h)
+{
+#ifdef PAL8_SSSE3
+	static const int ssse3=cpu_has_ssse3();
+	if(ssse3){
+		expand_ssse3(src,src_linesize,pal,dst,dst_linesize,w,h);
+		return;
+	}
+#endif
+	for(int y=0;y<h;y++)
+		expand_row_c(src+y*src_linesize,pal,dst+y*dst_linesize,0,w);
+}
+
+int pal8_bench(int w,int h)
+{
+	const int frame_num=50;
+	uint8_t *src=(uint8_t *)malloc((size_t)w*h*frame_num);
+	uint32_t *pals=(uint32_t *)malloc(256*4*frame_num);
+	uint8_t *dst_simd=(uint8_t *)malloc((size_t)w*h*3);
+	uint8_t *dst_sws=(uint8_t *)malloc((size_t)w*h*3);
+	uint8_t rgb_pal[256*4];
+	int64_t start,time_simd,time_sws;
+	int mismatch=0;
+
+	if(!src||!pals||!dst_simd||!dst_sws){
+		printf("Could not allocate benchmark buffers\n");
+		free(src);
+		free(pals);
+		free(dst_simd);
+		free(dst_sws);
+		return -1;
+	}
+	//Every frame has its own palette, as in GIF-derived sources
+	srand(1);
+	for(size_t i=0;i<(size_t)w*h*frame_num;i++)
+		src[i]=(uint8_t)rand();
+	for(int i=0;i<256*frame_num;i++)
+		pals[i]=0xFF000000|((uint32_t)rand()&0xFFFF)<<8|((uint32_t)rand()&0xFF);
+
+	start=av_gettime();
+	for(int f=0;f<frame_num;f++)
+		pal8_expand_rgb24(src+(size_t)f*w*h,w,pals+256*f,dst_simd,w*3,w,h);
+	time_simd=av_gettime()-start;
+
+	start=av_gettime();
+	for(int f=0;f<frame_num;f++){
+		//libswscale copies the first three bytes of each entry, so lay them out as R,G,B
+		for(int i=0;i<256;i++){
+			uint32_t c=pals[256*f+i];
+			rgb_pal[4*i]=(uint8_t)(c>>16);
+			rgb_pal[4*i+1]=(uint8_t)(c>>8);
+			rgb_pal[4*i+2]=(uint8_t)c;
+			rgb_pal[4*i+3]=0xFF;
+		}
+		for(int y=0;y<h;y++)
+			sws_convertPalette8ToPacked24(src+(size_t)f*w*h+y*w,dst_sws+y*w*3,w,rgb_pal);
+	}
+	time_sws=av_gettime()-start;
+
+	//Last frame of both must agree
+	mismatch=memcmp(dst_simd,dst_sws,(size_t)w*h*3)!=0;
+	printf("PAL8 -> RGB24 %dx%d, %d frames with per-frame palettes\n",w,h,frame_num);
+	printf("pal8_expand_rgb24:                 %8.3f ms/frame\n",time_simd/1000.0/frame_num);
+	printf("sws_convertPalette8ToPacked24:     %8.3f ms/frame\n",time_sws/1000.0/frame_num);
+	printf("Speedup %.2fx, output %s\n",time_simd>0?(double)time_sws/time_simd:0,mismatch?"DIFFERS":"identical");
+
+	free(src);
+	free(pals);
+	free(dst_simd);
+	free(dst_sws);
+	return mismatch?1:0;
+}
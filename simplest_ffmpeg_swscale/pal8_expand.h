@@ -0,0 +1,25 @@
+/**
+ * PAL8 input: expand indexed frames for the scaler
+ *
+ * A raw PAL8 frame is the w*h indices followed by its own 256 entry
+ * palette (1024 bytes, 0xAARRGGBB native endian), the layout batch mode
+ * writes for pal8 output. Frames are expanded to packed rgb24, which is
+ * then scaled like any other rgb24 input.
+ */
+
+#ifndef PAL8_EXPAND_H
+#define PAL8_EXPAND_H
+
+#include <stdint.h>
+
+//Size of one raw PAL8 frame, palette included
+int pal8_frame_size(int w,int h);
+
+//Expand indices through pal into packed rgb24. Uses SSSE3 when the CPU has it.
+void pal8_expand_rgb24(const uint8_t *src,int src_linesize,const uint32_t pal[256],
+					   uint8_t *dst,int dst_linesize,int w,int h);
+
+//-pal8bench: pal8_expand_rgb24() against sws_convertPalette8ToPacked24() row by row
+int pal8_bench(int w,int h);
+
+#endif
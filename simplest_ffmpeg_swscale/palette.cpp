@@ -0,0 +1,306 @@
+/**
+ * RGB24 to PAL8 quantization
+ *
+ * The inverse colour map is searched with SSE2 when available: four
+ * palette entries per step, distances from _mm_madd_epi16().
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)||defined(_M_X64)||(defined(_M_IX86_FP)&&_M_IX86_FP>=2)
+#define PALETTE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#include "palette.h"
+#include "alloc_track.h"
+
+#define HIST_BITS 5
+#define HIST_SIZE (1<<(3*HIST_BITS))
+#define CELL(r,g,b) ((((r)>>3)<<10)|(((g)>>3)<<5)|((b)>>3))
+//Every SUBSAMPLE-th pixel of every SUBSAMPLE-th row feeds the histogram and the drift check
+#define SUBSAMPLE 4
+
+//4x4 Bayer matrix, scaled to about the spacing of a 256-colour palette
+static const int8_t dither_offsets[4][4]={
+	{-16,  0,-12,  4},
+	{  8, -8, 12, -4},
+	{-10,  6,-14,  2},
+	{ 14, -2, 10, -6},
+};
+
+typedef struct Box{
+	int lo[3],hi[3];        //Inclusive histogram cell range per channel
+	int64_t count;
+}Box;
+
+struct PaletteQuantizer{
+	int dither;
+	double drift;
+	int valid;
+	double base_error;
+	uint32_t pal[256];
+	int nb_colors;
+	uint32_t hist[HIST_SIZE];
+	uint8_t inverse[HIST_SIZE];
+	PaletteStats stats;
+};
+
+PaletteQuantizer *palette_alloc(int dither,double drift)
+{
+	AllocScope scope(ALLOC_TAG_PALETTE);
+	PaletteQuantizer *pq=(PaletteQuantizer *)calloc(1,sizeof(PaletteQuantizer));
+	if(!pq)
+		return NULL;
+	pq->dither=dither;
+	pq->drift=drift;
+	return pq;
+}
+
+void palette_free(PaletteQuantizer **pq)
+{
+	AllocScope scope(ALLOC_TAG_PALETTE);
+	free(*pq);
+	*pq=NULL;
+}
+
+static inline uint8_t clip_uint8(int v)
+{
+	return v<0?0:v>255?255:v;
+}
+
+//Shrink the box to the cells that are actually populated and count them
+static void box_shrink(const uint32_t *hist,Box *box)
+{
+	int lo[3]={31,31,31},hi[3]={0,0,0};
+	box->count=0;
+	for(int r=box->lo[0];r<=box->hi[0];r++){
+		for(int g=box->lo[1];g<=box->hi[1];g++){
+			for(int b=box->lo[2];b<=box->hi[2];b++){
+				uint32_t n=hist[(r<<10)|(g<<5)|b];
+				if(!n)
+					continue;
+				box->count+=n;
+				if(r<lo[0]) lo[0]=r;
+				if(r>hi[0]) hi[0]=r;
+				if(g<lo[1]) lo[1]=g;
+				if(g>hi[1]) hi[1]=g;
+				if(b<lo[2]) lo[2]=b;
+				if(b>hi[2]) hi[2]=b;
+			}
+		}
+	}
+	if(box->count){
+		memcpy(box->lo,lo,sizeof(lo));
+		memcpy(box->hi,hi,sizeof(hi));
+	}
+}
+
+//Split at the median of the longest side, 0 if the box is a single cell
+static int box_split(const uint32_t *hist,Box *box,Box *other)
+{
+	int axis=0,len=-1,cut;
+	int64_t half,sum=0;
+	for(int c=0;c<3;c++){
+		if(box->hi[c]-box->lo[c]>len){
+			len=box->hi[c]-box->lo[c];
+			axis=c;
+		}
+	}
+	if(len<=0)
+		return 0;
+	half=box->count/2;
+	for(cut=box->lo[axis];cut<box->hi[axis];cut++){
+		Box slice=*box;
+		slice.lo[axis]=slice.hi[axis]=cut;
+		box_shrink(hist,&slice);
+		sum+=slice.count;
+		if(sum>=half)
+			break;
+	}
+	if(cut>=box->hi[axis])
+		cut=box->hi[axis]-1;
+	*other=*box;
+	box->hi[axis]=cut;
+	other->lo[axis]=cut+1;
+	box_shrink(hist,box);
+	box_shrink(hist,other);
+	return 1;
+}
+
+static uint32_t box_color(const uint32_t *hist,const Box *box)
+{
+	int64_t sum[3]={0,0,0},n=0;
+	for(int r=box->lo[0];r<=box->hi[0];r++){
+		for(int g=box->lo[1];g<=box->hi[1];g++){
+			for(int b=box->lo[2];b<=box->hi[2];b++){
+				uint32_t c=hist[(r<<10)|(g<<5)|b];
+				sum[0]+=(int64_t)c*(r*8+4);
+				sum[1]+=(int64_t)c*(g*8+4);
+				sum[2]+=(int64_t)c*(b*8+4);
+				n+=c;
+			}
+		}
+	}
+	if(!n)
+		return 0xFF000000;
+	return 0xFF000000|(uint32_t)(sum[0]/n)<<16|(uint32_t)(sum[1]/n)<<8|(uint32_t)(sum[2]/n);
+}
+
+static void build_palette(PaletteQuantizer *pq,const uint8_t *rgb,int rgb_linesize,int w,int h)
+{
+	Box boxes[256];
+	int nb_boxes=1;
+
+	memset(pq->hist,0,sizeof(pq->hist));
+	for(int y=0;y<h;y+=SUBSAMPLE){
+		const uint8_t *p=rgb+y*rgb_linesize;
+		for(int x=0;x<w;x+=SUBSAMPLE,p+=3*SUBSAMPLE)
+			pq->hist[CELL(p[0],p[1],p[2])]++;
+	}
+	for(int c=0;c<3;c++){
+		boxes[0].lo[c]=0;
+		boxes[0].hi[c]=31;
+	}
+	box_shrink(pq->hist,&boxes[0]);
+
+	//Split the box with the most pixels times extent until the palette is full
+	while(nb_boxes<256){
+		int best=-1;
+		int64_t best_score=0;
+		for(int i=0;i<nb_boxes;i++){
+			int len=0;
+			for(int c=0;c<3;c++){
+				if(boxes[i].hi[c]-boxes[i].lo[c]>len)
+					len=boxes[i].hi[c]-boxes[i].lo[c];
+			}
+			if(len&&boxes[i].count*len>best_score){
+				best_score=boxes[i].count*len;
+				best=i;
+			}
+		}
+		if(best<0||!box_split(pq->hist,&boxes[best],&boxes[nb_boxes]))
+			break;
+		nb_boxes++;
+	}
+
+	pq->nb_colors=nb_boxes;
+	for(int i=0;i<256;i++)
+		pq->pal[i]=i<nb_boxes?box_color(pq->hist,&boxes[i]):0xFF000000;
+}
+
+//Nearest palette entry for every histogram cell
+static void build_inverse(PaletteQuantizer *pq)
+{
+	int n=pq->nb_colors;
+#ifdef PALETTE_SSE2
+	//Entries as (r,g) and (b,0) int16 pairs, padded with far away colours
+	int16_t rg[512+8],b0[512+8];
+	int padded=(n+3)&~3;
+	for(int i=0;i<padded;i++){
+		uint32_t c=pq->pal[i<n?i:0];
+		int far=i>=n?1024:0;
+		rg[2*i]=(int16_t)(((c>>16)&0xFF)+far);
+		rg[2*i+1]=(int16_t)((c>>8)&0xFF);
+		b0[2*i]=(int16_t)(c&0xFF);
+		b0[2*i+1]=0;
+	}
+	for(int cell=0;cell<HIST_SIZE;cell++){
+		int r=((cell>>10)&31)*8+4,g=((cell>>5)&31)*8+4,b=(cell&31)*8+4;
+		__m128i crg=_mm_set1_epi32((g<<16)|r);
+		__m128i cb0=_mm_set1_epi32(b);
+		__m128i best=_mm_set1_epi32(0x7FFFFFFF);
+		__m128i best_idx=_mm_setzero_si128();
+		__m128i idx=_mm_set_epi32(3,2,1,0);
+		const __m128i four=_mm_set1_epi32(4);
+		for(int i=0;i<padded;i+=4){
+			__m128i d1=_mm_sub_epi16(_mm_loadu_si128((const __m128i *)&rg[2*i]),crg);
+			__m128i d2=_mm_sub_epi16(_mm_loadu_si128((const __m128i *)&b0[2*i]),cb0);
+			__m128i dist=_mm_add_epi32(_mm_madd_epi16(d1,d1),_mm_madd_epi16(d2,d2));
+			__m128i less=_mm_cmplt_epi32(dist,best);
+			best=_mm_or_si128(_mm_and_si128(less,dist),_mm_andnot_si128(less,best));
+			best_idx=_mm_or_si128(_mm_and_si128(less,idx),_mm_andnot_si128(less,best_idx));
+			idx=_mm_add_epi32(idx,four);
+		}
+		int32_t d[4],k[4];
+		_mm_storeu_si128((__m128i *)d,best);
+		_mm_storeu_si128((__m128i *)k,best_idx);
+		int m=0;
+		for(int j=1;j<4;j++){
+			if(d[j]<d[m]||(d[j]==d[m]&&k[j]<k[m]))
+				m=j;
+		}
+		pq->inverse[cell]=(uint8_t)k[m];
+	}
+#else
+	for(int cell=0;cell<HIST_SIZE;cell++){
+		int r=((cell>>10)&31)*8+4,g=((cell>>5)&31)*8+4,b=(cell&31)*8+4;
+		int best=0x7FFFFFFF,best_idx=0;
+		for(int i=0;i<n;i++){
+			uint32_t c=pq->pal[i];
+			int dr=(int)((c>>16)&0xFF)-r,dg=(int)((c>>8)&0xFF)-g,db=(int)(c&0xFF)-b;
+			int dist=dr*dr+dg*dg+db*db;
+			if(dist<best){
+				best=dist;
+				best_idx=i;
+			}
+		}
+		pq->inverse[cell]=(uint8_t)best_idx;
+	}
+#endif
+}
+
+//Mean squared error of the current palette on a subsample
+static double palette_error(PaletteQuantizer *pq,const uint8_t *rgb,int rgb_linesize,int w,int h)
+{
+	int64_t sum=0,n=0;
+	for(int y=0;y<h;y+=SUBSAMPLE){
+		const uint8_t *p=rgb+y*rgb_linesize;
+		for(int x=0;x<w;x+=SUBSAMPLE,p+=3*SUBSAMPLE){
+			uint32_t c=pq->pal[pq->inverse[CELL(p[0],p[1],p[2])]];
+			int dr=(int)((c>>16)&0xFF)-p[0],dg=(int)((c>>8)&0xFF)-p[1],db=(int)(c&0xFF)-p[2];
+			sum+=dr*dr+dg*dg+db*db;
+			n++;
+		}
+	}
+	return n?(double)sum/n:0;
+}
+
+void palette_quantize(PaletteQuantizer *pq,const uint8_t *rgb,int rgb_linesize,int w,int h,
+					  uint8_t *dst,int dst_linesize,uint32_t pal[256])
+{
+	double error=pq->valid?palette_error(pq,rgb,rgb_linesize,w,h):0;
+	//The +1 keeps a near perfect palette from being rebuilt on noise
+	if(!pq->valid||(pq->drift>=0&&error>pq->base_error*(1+pq->drift)+1)){
+		build_palette(pq,rgb,rgb_linesize,w,h);
+		build_inverse(pq);
+		error=palette_error(pq,rgb,rgb_linesize,w,h);
+		pq->base_error=error;
+		pq->valid=1;
+		pq->stats.rebuilds++;
+	}
+	pq->stats.frames++;
+	pq->stats.error=error;
+
+	for(int y=0;y<h;y++){
+		const uint8_t *p=rgb+y*rgb_linesize;
+		uint8_t *q=dst+y*dst_linesize;
+		if(pq->dither){
+			const int8_t *row=dither_offsets[y&3];
+			for(int x=0;x<w;x++,p+=3){
+				int o=row[x&3];
+				q[x]=pq->inverse[CELL(clip_uint8(p[0]+o),clip_uint8(p[1]+o),clip_uint8(p[2]+o))];
+			}
+		}else{
+			for(int x=0;x<w;x++,p+=3)
+				q[x]=pq->inverse[CELL(p[0],p[1],p[2])];
+		}
+	}
+	memcpy(pal,pq->pal,sizeof(pq->pal));
+}
+
+void palette_get_stats(PaletteQuantizer *pq,PaletteStats *stats)
+{
+	*stats=pq->stats;
+}
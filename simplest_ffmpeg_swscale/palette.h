@@ -0,0 +1,42 @@
+/**
+ * RGB24 to PAL8 quantization
+ *
+ * The palette is built by median cut over a histogram of a subsampled
+ * frame (5 bits per channel). An inverse colour map (one palette index per
+ * histogram cell) is built with it, so mapping a pixel is one table lookup.
+ * Optional 4x4 ordered dithering hides the banding of flat gradients.
+ *
+ * A palette is kept across frames while it still fits: every frame the
+ * quantization error of a subsample is compared with the error the palette
+ * had when it was built, and the palette is rebuilt once the error has
+ * grown by more than the drift threshold.
+ */
+
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <stdint.h>
+
+//Default drift threshold: rebuild when the error grows by half
+#define PALETTE_DEFAULT_DRIFT 0.5
+
+typedef struct PaletteStats{
+	int64_t frames;
+	int64_t rebuilds;
+	double error;           //Mean squared error of the last frame (subsample)
+}PaletteStats;
+
+typedef struct PaletteQuantizer PaletteQuantizer;
+
+//drift<0: build the palette once and keep it
+PaletteQuantizer *palette_alloc(int dither,double drift);
+void palette_free(PaletteQuantizer **pq);
+
+//Map an RGB24 frame to palette indices. pal receives the 256 entries in
+//the FFmpeg PAL8 layout (0xAARRGGBB, native endian). Does not allocate.
+void palette_quantize(PaletteQuantizer *pq,const uint8_t *rgb,int rgb_linesize,int w,int h,
+					  uint8_t *dst,int dst_linesize,uint32_t pal[256]);
+
+void palette_get_stats(PaletteQuantizer *pq,PaletteStats *stats);
+
+#endif
@@ -0,0 +1,147 @@
+/**
+ * Generated frames from RAM
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+extern "C"
+{
+#include "libavutil/imgutils.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/time.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/time.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+#include "pattern_source.h"
+#include "batch.h"
+
+PatternSource::PatternSource()
+	:nb_frames(0),served(0)
+{
+}
+
+int PatternSource::open(const PatternSpec &spec,int w,int h,AVPixelFormat pixfmt,int nb_cached,int64_t nb_frames)
+{
+	PatternSpec s=spec;
+
+	close();
+	if(nb_cached<=0||pattern_check_pixfmt(pixfmt)<0)
+		return -1;
+	cache.resize(nb_cached);
+	for(int i=0;i<nb_cached;i++){
+		s.frame=spec.frame+i;
+		if(cache[i].alloc(w,h,pixfmt)<0||
+			pattern_fill(&s,cache[i].data(),cache[i].linesize(),pixfmt,w,h)<0){
+			close();
+			return -1;
+		}
+	}
+	this->nb_frames=nb_frames;
+	served=0;
+	return 0;
+}
+
+void PatternSource::close()
+{
+	cache.clear();
+	nb_frames=0;
+	served=0;
+}
+
+int PatternSource::read(Frame &frame)
+{
+	if(cache.empty())
+		return -1;
+	const Frame &src=cache[served%(int64_t)cache.size()];
+	if(frame.width()!=src.width()||frame.height()!=src.height()||frame.pixfmt()!=src.pixfmt())
+		return -1;
+	if(served==nb_frames)
+		return 0;
+	av_image_copy((uint8_t **)frame.data(),(int *)frame.linesize(),
+		(const uint8_t **)src.data(),src.linesize(),src.pixfmt(),src.width(),src.height());
+	served++;
+	return 1;
+}
+
+//Enough different frames that the source is not a single hot buffer
+#define BENCH_CACHED_FRAMES 8
+
+int scale_bench(AVPixelFormat src_pixfmt,int src_w,int src_h,
+				AVPixelFormat dst_pixfmt,int dst_w,int dst_h,
+				int flags,int nb_frames,const char *pattern)
+{
+	PatternSpec spec;
+	PatternSource source;
+	NullSink sink;
+	Scaler scaler;
+	Frame src,dst;
+	int64_t start,time_sws,time_loop,frames;
+	double src_mpix=(double)src_w*src_h/1e6;
+
+	if(pattern_preset(&spec,pattern)<0){
+		printf("Unknown pattern: %s\n",pattern);
+		return -1;
+	}
+	if(nb_frames<=0){
+		printf("Frame count must be positive\n");
+		return -1;
+	}
+	if(source.open(spec,src_w,src_h,src_pixfmt,pattern_is_still(&spec)?1:BENCH_CACHED_FRAMES,nb_frames)<0){
+		printf("Could not draw %s frames in %s %dx%d\n",pattern,av_get_pix_fmt_name(src_pixfmt),src_w,src_h);
+		return -1;
+	}
+	if(src.alloc(src_w,src_h,src_pixfmt)<0||dst.alloc(dst_w,dst_h,dst_pixfmt)<0){
+		printf("Could not allocate benchmark frames\n");
+		return -1;
+	}
+	if(scaler.init(src_w,src_h,src_pixfmt,dst_w,dst_h,dst_pixfmt,flags)<0){
+		printf("Could not create context for %s -> %s\n",
+			av_get_pix_fmt_name(src_pixfmt),av_get_pix_fmt_name(dst_pixfmt));
+		return -1;
+	}
+	//The first call sets up the scaler's internal buffers, keep it out of the timing
+	if(scaler.scale(source.cached(0),dst)<0)
+		return -1;
+
+	start=av_gettime();
+	for(int i=0;i<nb_frames;i++){
+		if(scaler.scale(source.cached(i),dst)<0)
+			return -1;
+	}
+	time_sws=av_gettime()-start;
+
+	start=av_gettime();
+	frames=scale_frames(source,scaler,sink,src,dst);
+	time_loop=av_gettime()-start;
+	if(frames!=nb_frames)
+		return -1;
+
+	printf("%s %dx%d -> %s %dx%d %s, %d frames of %s (%d in RAM)\n",
+		av_get_pix_fmt_name(src_pixfmt),src_w,src_h,av_get_pix_fmt_name(dst_pixfmt),dst_w,dst_h,
+		sws_flags_name(flags),nb_frames,pattern,source.nb_cached());
+	printf("sws_scale:                         %8.3f ms/frame %8.1f fps %8.1f Mpixel/s\n",
+		time_sws/1000.0/nb_frames,time_sws>0?nb_frames*1e6/time_sws:0,
+		time_sws>0?src_mpix*nb_frames*1e6/time_sws:0);
+	printf("scale_frames (source, sink):       %8.3f ms/frame %8.1f fps %8.1f Mpixel/s\n",
+		time_loop/1000.0/nb_frames,time_loop>0?nb_frames*1e6/time_loop:0,
+		time_loop>0?src_mpix*nb_frames*1e6/time_loop:0);
+	return 0;
+}
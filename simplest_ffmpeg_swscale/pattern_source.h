@@ -0,0 +1,63 @@
+/**
+ * Generated frames from RAM
+ *
+ * PatternSource draws a few frames of a simplest_pic_gen pattern (see
+ * ../simplest_pic_gen/pattern.h) when it is opened and then serves them in
+ * a loop, so a conversion can be run without any input file and without
+ * disk reads in the measurement. NullSink drops the output.
+ *
+ * scale_bench() uses both to time sws_scale() alone and the whole
+ * scale_frames() loop on the same frames.
+ */
+
+#ifndef PATTERN_SOURCE_H
+#define PATTERN_SOURCE_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "scaler.h"
+#include "../simplest_pic_gen/pattern.h"
+
+class PatternSource:public FrameSource{
+public:
+	PatternSource();
+	PatternSource(const PatternSource &)=delete;
+	PatternSource &operator=(const PatternSource &)=delete;
+
+	//Draw nb_cached frames of spec (frame numbers spec.frame onwards; 1 is
+	//enough for still patterns), then serve nb_frames of them in turn
+	int open(const PatternSpec &spec,int w,int h,AVPixelFormat pixfmt,int nb_cached,int64_t nb_frames);
+	void close();
+	//Start over with the first frame
+	void rewind() { served=0; }
+
+	//frame must be allocated with the size and format given to open()
+	int read(Frame &frame);
+
+	int nb_cached() const { return (int)cache.size(); }
+	//Frame i modulo nb_cached()
+	const Frame &cached(int i) const { return cache[i%cache.size()]; }
+
+private:
+	std::vector<Frame> cache;
+	int64_t nb_frames,served;
+};
+
+//Discards every frame
+class NullSink:public FrameSink{
+public:
+	NullSink():frames(0) {}
+	int write(const Frame &frame) { frames++; return 0; }
+
+	int64_t frames;
+};
+
+//Time the conversion of nb_frames frames of pattern (a pattern_preset()
+//name) from src to dst: sws_scale() alone, then with PatternSource and
+//NullSink around it
+int scale_bench(AVPixelFormat src_pixfmt,int src_w,int src_h,
+				AVPixelFormat dst_pixfmt,int dst_w,int dst_h,
+				int flags,int nb_frames,const char *pattern);
+
+#endif
@@ -0,0 +1,217 @@
+/**
+ * Hardware performance counters per pipeline stage
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+extern "C"
+{
+#include "libavutil/time.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libavutil/time.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+#include "perf_counters.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+struct PerfCounters{
+	int fd[PERF_NB_EVENTS];
+	int available;
+};
+
+static const char *const event_names[PERF_NB_EVENTS]={
+	"cycles","instructions","LLC misses","dTLB misses","branch misses"
+};
+
+#ifdef __linux__
+static const struct{
+	uint32_t type;
+	uint64_t config;
+}event_attrs[PERF_NB_EVENTS]={
+	{PERF_TYPE_HARDWARE,PERF_COUNT_HW_CPU_CYCLES},
+	{PERF_TYPE_HARDWARE,PERF_COUNT_HW_INSTRUCTIONS},
+	{PERF_TYPE_HW_CACHE,PERF_COUNT_HW_CACHE_LL|(PERF_COUNT_HW_CACHE_OP_READ<<8)|(PERF_COUNT_HW_CACHE_RESULT_MISS<<16)},
+	{PERF_TYPE_HW_CACHE,PERF_COUNT_HW_CACHE_DTLB|(PERF_COUNT_HW_CACHE_OP_READ<<8)|(PERF_COUNT_HW_CACHE_RESULT_MISS<<16)},
+	{PERF_TYPE_HARDWARE,PERF_COUNT_HW_BRANCH_MISSES}
+};
+
+static int open_event(int event)
+{
+	struct perf_event_attr attr;
+	memset(&attr,0,sizeof(attr));
+	attr.size=sizeof(attr);
+	attr.type=event_attrs[event].type;
+	attr.config=event_attrs[event].config;
+	attr.read_format=PERF_FORMAT_TOTAL_TIME_ENABLED|PERF_FORMAT_TOTAL_TIME_RUNNING;
+	//User space only, allowed at perf_event_paranoid 2
+	attr.exclude_kernel=1;
+	attr.exclude_hv=1;
+	return (int)syscall(__NR_perf_event_open,&attr,0,-1,-1,0);
+}
+#endif
+
+PerfCounters *perf_counters_alloc(void)
+{
+	PerfCounters *pc=(PerfCounters *)calloc(1,sizeof(PerfCounters));
+	if(!pc)
+		return NULL;
+	for(int i=0;i<PERF_NB_EVENTS;i++)
+		pc->fd[i]=-1;
+#ifdef __linux__
+	int err=0;
+	for(int i=0;i<PERF_NB_EVENTS;i++){
+		pc->fd[i]=open_event(i);
+		if(pc->fd[i]>=0)
+			pc->available|=1<<i;
+		else if(!err)
+			err=errno;
+	}
+	if(err){
+		printf("Performance counters not available:");
+		for(int i=0;i<PERF_NB_EVENTS;i++){
+			if(!(pc->available&(1<<i)))
+				printf(" %s",event_names[i]);
+		}
+		printf(" (%s)\n",strerror(err));
+	}
+#else
+	printf("Performance counters not available on this platform, reporting time only\n");
+#endif
+	return pc;
+}
+
+void perf_counters_free(PerfCounters **pc)
+{
+	if(!*pc)
+		return;
+#ifdef __linux__
+	for(int i=0;i<PERF_NB_EVENTS;i++){
+		if((*pc)->fd[i]>=0)
+			close((*pc)->fd[i]);
+	}
+#endif
+	free(*pc);
+	*pc=NULL;
+}
+
+int perf_counters_available(const PerfCounters *pc)
+{
+	return pc?pc->available:0;
+}
+
+void perf_counters_read(PerfCounters *pc,PerfReading readings[PERF_NB_EVENTS])
+{
+	for(int i=0;i<PERF_NB_EVENTS;i++){
+		memset(&readings[i],0,sizeof(readings[i]));
+#ifdef __linux__
+		uint64_t buf[3];        //value, time enabled, time running
+		if(!pc||pc->fd[i]<0||read(pc->fd[i],buf,sizeof(buf))!=(ssize_t)sizeof(buf))
+			continue;
+		readings[i].value=buf[0];
+		readings[i].time_enabled=buf[1];
+		readings[i].time_running=buf[2];
+#endif
+	}
+}
+
+uint64_t perf_reading_delta(const PerfReading *start,const PerfReading *end)
+{
+	uint64_t value=end->value-start->value;
+	uint64_t enabled=end->time_enabled-start->time_enabled;
+	uint64_t running=end->time_running-start->time_running;
+	if(running==0)
+		return 0;
+	//Multiplexed with other events during the interval: extrapolate. The
+	//cumulative ratio would be wrong as soon as it changes between reads.
+	if(running<enabled)
+		return (uint64_t)((double)value*enabled/running);
+	return value;
+}
+
+void perf_stage_init(PerfStage *stage,const char *name)
+{
+	memset(stage,0,sizeof(*stage));
+	stage->name=name;
+}
+
+void perf_stage_begin(PerfCounters *pc,PerfStage *stage)
+{
+	stage->available=perf_counters_available(pc);
+	stage->start_time=av_gettime();
+	perf_counters_read(pc,stage->start);
+}
+
+void perf_stage_end(PerfCounters *pc,PerfStage *stage,int64_t pixels)
+{
+	PerfReading now[PERF_NB_EVENTS];
+	perf_counters_read(pc,now);
+	stage->last_time=av_gettime()-stage->start_time;
+	stage->last_pixels=pixels;
+	for(int i=0;i<PERF_NB_EVENTS;i++){
+		stage->last[i]=perf_reading_delta(&stage->start[i],&now[i]);
+		stage->total[i]+=stage->last[i];
+	}
+	stage->total_time+=stage->last_time;
+	stage->total_pixels+=pixels;
+	stage->frames++;
+}
+
+//"n/a" in the same width when a counter is missing
+static void print_figure(int ok,double value,int width,int precision)
+{
+	if(ok)
+		printf(" %*.*f",width,precision,value);
+	else
+		printf(" %*s",width,"n/a");
+}
+
+static void print_counts(int available,const uint64_t counts[PERF_NB_EVENTS],int64_t pixels)
+{
+	double kpix=pixels>0?pixels/1000.0:1;
+	int have_ipc=(available&(1<<PERF_CYCLES))&&(available&(1<<PERF_INSTRUCTIONS))&&counts[PERF_CYCLES]>0;
+	print_figure(have_ipc,have_ipc?(double)counts[PERF_INSTRUCTIONS]/counts[PERF_CYCLES]:0,5,2);
+	print_figure(available&(1<<PERF_LLC_MISSES),counts[PERF_LLC_MISSES]/kpix,8,3);
+	print_figure(available&(1<<PERF_DTLB_MISSES),counts[PERF_DTLB_MISSES]/kpix,9,3);
+	print_figure(available&(1<<PERF_BRANCH_MISSES),counts[PERF_BRANCH_MISSES]/kpix,11,3);
+}
+
+void perf_stage_print_frame(const PerfStage *stage,int frame_idx)
+{
+	printf("Frame %5d %-6s %8.3f ms  IPC/LLC/dTLB/branch per kpix:",frame_idx,stage->name,stage->last_time/1000.0);
+	print_counts(stage->available,stage->last,stage->last_pixels);
+	printf("\n");
+}
+
+void perf_stage_print_summary(const PerfStage *stages,int nb_stages)
+{
+	printf("stage    frames  ms/frame   IPC LLC/kpix dTLB/kpix branch/kpix Mcycles/frame\n");
+	for(int s=0;s<nb_stages;s++){
+		const PerfStage *st=&stages[s];
+		int64_t frames=st->frames>0?st->frames:1;
+		printf("%-6s %8lld %9.3f",st->name,(long long)st->frames,st->total_time/1000.0/frames);
+		print_counts(st->available,st->total,st->total_pixels);
+		print_figure(st->available&(1<<PERF_CYCLES),st->total[PERF_CYCLES]/1e6/frames,13,3);
+		printf("\n");
+	}
+}
@@ -0,0 +1,84 @@
+/**
+ * Hardware performance counters per pipeline stage
+ *
+ * Counts cycles, instructions, last level cache misses, dTLB misses and
+ * branch misses of the calling thread with perf_event_open(), user space
+ * only, so it works with the default perf_event_paranoid=2. Each counter
+ * is opened on its own: one the host or container does not provide (no
+ * PMU in a VM, seccomp, paranoid=3) is left out and shown as n/a, and
+ * without any of them only the time is reported. When the kernel
+ * multiplexes the counters, each stage's count is scaled by how long the
+ * counter ran during that stage.
+ *
+ *   PerfCounters *pc=perf_counters_alloc();
+ *   PerfStage scale;
+ *   perf_stage_init(&scale,"scale");
+ *   perf_stage_begin(pc,&scale);
+ *   sws_scale(...);
+ *   perf_stage_end(pc,&scale,dst_w*dst_h);
+ *   perf_stage_print_frame(&scale,frame_idx);
+ *
+ * IPC tells whether the stage keeps the core busy; LLC and dTLB misses
+ * per kilopixel tell whether it waits for memory.
+ */
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdint.h>
+
+typedef enum PerfEvent{
+	PERF_CYCLES=0,
+	PERF_INSTRUCTIONS,
+	PERF_LLC_MISSES,
+	PERF_DTLB_MISSES,
+	PERF_BRANCH_MISSES,
+	PERF_NB_EVENTS
+}PerfEvent;
+
+typedef struct PerfCounters PerfCounters;
+
+//Counters of the calling thread. Never fails for lack of counters (see
+//perf_counters_available()), NULL only if out of memory.
+PerfCounters *perf_counters_alloc(void);
+void perf_counters_free(PerfCounters **pc);
+
+//Bit (1<<event) set for every counter that could be opened
+int perf_counters_available(const PerfCounters *pc);
+
+//Raw count, and the time the counter was enabled and actually counting:
+//less when multiplexed with other events
+typedef struct PerfReading{
+	uint64_t value;
+	uint64_t time_enabled,time_running;
+}PerfReading;
+
+//Current readings, 0 for unavailable counters
+void perf_counters_read(PerfCounters *pc,PerfReading readings[PERF_NB_EVENTS]);
+
+//Count between two readings, extrapolated to the whole interval if the
+//counter ran for only part of it (0 if it did not run at all)
+uint64_t perf_reading_delta(const PerfReading *start,const PerfReading *end);
+
+//Counts of one stage of the conversion loop: the last frame and the total
+typedef struct PerfStage{
+	const char *name;
+	int available;
+	PerfReading start[PERF_NB_EVENTS];
+	int64_t start_time;
+	uint64_t last[PERF_NB_EVENTS];
+	int64_t last_time,last_pixels;
+	uint64_t total[PERF_NB_EVENTS];
+	int64_t total_time,total_pixels,frames;
+}PerfStage;
+
+void perf_stage_init(PerfStage *stage,const char *name);
+void perf_stage_begin(PerfCounters *pc,PerfStage *stage);
+//pixels: of the frame the stage worked on, for the per kilopixel figures
+void perf_stage_end(PerfCounters *pc,PerfStage *stage,int64_t pixels);
+
+//One line for the last frame, and a table of the totals of all stages
+void perf_stage_print_frame(const PerfStage *stage,int frame_idx);
+void perf_stage_print_summary(const PerfStage *stages,int nb_stages);
+
+#endif
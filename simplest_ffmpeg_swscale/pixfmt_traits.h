@@ -0,0 +1,65 @@
+/**
+ * Compile-time description of the supported pixel formats
+ *
+ * PixFmtTraits<fmt> gives the plane layout of a raw frame (see frame_io.h)
+ * as constexpr constants, so loops instantiated per format have fixed plane counts
+ * and shifts the compiler can unroll. Planes after the first share one
+ * subsampled size.
+ */
+
+#ifndef PIXFMT_TRAITS_H
+#define PIXFMT_TRAITS_H
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+extern "C"
+{
+#include "libavutil/pixfmt.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libavutil/pixfmt.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+template<AVPixelFormat F> struct PixFmtTraits;
+
+#define DECLARE_PIXFMT_TRAITS(fmt,planes,log2_cw,log2_ch,luma_bpp,chroma_bpp) \
+template<> struct PixFmtTraits<fmt>{ \
+	static constexpr AVPixelFormat pixfmt=fmt; \
+	static constexpr int nb_planes=planes; \
+	static constexpr int log2_chroma_w=log2_cw; \
+	static constexpr int log2_chroma_h=log2_ch; \
+	static constexpr int luma_bytes=luma_bpp;     /*Bytes per pixel in plane 0*/ \
+	static constexpr int chroma_bytes=chroma_bpp; /*Bytes per sample in the other planes*/ \
+};
+
+//                     format                  planes  cw  ch  luma  chroma
+DECLARE_PIXFMT_TRAITS(AV_PIX_FMT_GRAY8,        1,      0,  0,  1,    0)
+DECLARE_PIXFMT_TRAITS(AV_PIX_FMT_YUV420P,      3,      1,  1,  1,    1)
+DECLARE_PIXFMT_TRAITS(AV_PIX_FMT_YUV422P,      3,      1,  0,  1,    1)
+DECLARE_PIXFMT_TRAITS(AV_PIX_FMT_YUV444P,      3,      0,  0,  1,    1)
+DECLARE_PIXFMT_TRAITS(AV_PIX_FMT_YUYV422,      1,      0,  0,  2,    0)
+DECLARE_PIXFMT_TRAITS(AV_PIX_FMT_RGB24,        1,      0,  0,  3,    0)
+
+//Bytes of plane p in a raw frame
+template<class T> constexpr int plane_size(int p,int w,int h)
+{
+	return p==0?w*h*T::luma_bytes:
+		(w>>T::log2_chroma_w)*(h>>T::log2_chroma_h)*T::chroma_bytes;
+}
+
+template<class T> constexpr int frame_size(int w,int h)
+{
+	return plane_size<T>(0,w,h)+(T::nb_planes-1)*plane_size<T>(1,w,h);
+}
+
+#endif
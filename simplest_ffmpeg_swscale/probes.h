@@ -0,0 +1,60 @@
+/**
+ * USDT probes for tracing a running converter
+ *
+ * When <sys/sdt.h> (systemtap-sdt-dev) is installed, the converter is built
+ * with statically defined tracing probes of provider simplest_swscale:
+ *
+ *   frame_start(job,frame)          frame_end(job,frame,status)
+ *   scale_start(ctx,src_h)          scale_end(ctx,src_h)
+ *   io_submit(op)                   io_complete(op,ret)
+ *   context_create(ctx,src_w,src_h,src_pixfmt,dst_w,dst_h,dst_pixfmt,flags)
+ *
+ * job is the manifest line (-1 outside batch, streams and real-time mode),
+ * status 0, 1 at the end of the input (no frame) or <0 on an error,
+ * op PROBE_IO_READ or PROBE_IO_WRITE, ret the bytes read or, for a write, 0
+ * (<0 on an error). Unattached, a probe is one nop instruction and its
+ * arguments are values that are at hand anyway, so normal runs do not pay
+ * for them. A live job can then be traced without a restart, e.g. for
+ * sws_scale() calls slower than 20 ms:
+ *
+ *   bpftrace -p PID -e 'usdt:*:simplest_swscale:scale_start { @t[tid]=nsecs; }
+ *     usdt:*:simplest_swscale:scale_end /@t[tid]/ { $d=(nsecs-@t[tid])/1000;
+ *     if($d>20000){ printf("ctx %p: %d us\n",arg0,$d); } delete(@t[tid]); }'
+ *
+ * "readelf -n simplest_ffmpeg_swscale.out" lists the probes. Without
+ * <sys/sdt.h>, or with NO_USDT defined, the macros expand to nothing.
+ */
+
+#ifndef PROBES_H
+#define PROBES_H
+
+#if defined(__linux__)&&!defined(NO_USDT)&&defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define HAVE_USDT 1
+#endif
+#endif
+
+#define PROBE_IO_READ  0
+#define PROBE_IO_WRITE 1
+
+#ifdef HAVE_USDT
+#define PROBE_FRAME_START(job,frame) STAP_PROBE2(simplest_swscale,frame_start,job,frame)
+#define PROBE_FRAME_END(job,frame,status) STAP_PROBE3(simplest_swscale,frame_end,job,frame,status)
+#define PROBE_SCALE_START(ctx,src_h) STAP_PROBE2(simplest_swscale,scale_start,ctx,src_h)
+#define PROBE_SCALE_END(ctx,src_h) STAP_PROBE2(simplest_swscale,scale_end,ctx,src_h)
+#define PROBE_IO_SUBMIT(op) STAP_PROBE1(simplest_swscale,io_submit,op)
+#define PROBE_IO_COMPLETE(op,ret) STAP_PROBE2(simplest_swscale,io_complete,op,ret)
+#define PROBE_CONTEXT_CREATE(ctx,src_w,src_h,src_pixfmt,dst_w,dst_h,dst_pixfmt,flags) \
+	STAP_PROBE8(simplest_swscale,context_create,ctx,src_w,src_h,(int)(src_pixfmt),dst_w,dst_h,(int)(dst_pixfmt),flags)
+#else
+#define PROBE_FRAME_START(job,frame)
+#define PROBE_FRAME_END(job,frame,status)
+#define PROBE_SCALE_START(ctx,src_h)
+#define PROBE_SCALE_END(ctx,src_h)
+#define PROBE_IO_SUBMIT(op)
+#define PROBE_IO_COMPLETE(op,ret)
+#define PROBE_CONTEXT_CREATE(ctx,src_w,src_h,src_pixfmt,dst_w,dst_h,dst_pixfmt,flags)
+#endif
+
+#endif
@@ -0,0 +1,263 @@
+/**
+ * Real-time mode: convert at a fixed frame rate for live outputs
+ *
+ * The cost of each scaler is tracked separately, so stepping back up is
+ * decided on what the better scaler actually cost last time it ran.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+extern "C"
+{
+#include "libswscale/swscale.h"
+#include "libavutil/time.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libswscale/swscale.h>
+#include <libavutil/time.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+#include "realtime.h"
+#include "batch.h"
+#include "frame_io.h"
+#include "sws_cache.h"
+#include "probes.h"
+
+//Scalers from best to cheapest
+static const int quality_levels[]={SWS_BICUBIC,SWS_BILINEAR,SWS_FAST_BILINEAR};
+#define NB_QUALITY_LEVELS ((int)(sizeof(quality_levels)/sizeof(quality_levels[0])))
+
+//Step down above this share of the frame budget, up below the lower one
+#define BUDGET_HIGH 0.8
+#define BUDGET_LOW  0.5
+//Frames to stay on a level before stepping up again, and after which the
+//cost measured on another level is out of date
+#define HOLD_FRAMES 25
+
+typedef struct RealtimeStats{
+	int frames;
+	int missed;
+	int switches;
+	int level_frames[NB_QUALITY_LEVELS];
+}RealtimeStats;
+
+//job_idx: for the probes (see probes.h)
+static int run_realtime_job(const JobSpec *job,int job_idx,SwsCache *cache,double fps,RealtimeStats *rs)
+{
+	int src_size=raw_frame_size(job->src_pixfmt,job->src_w,job->src_h);
+	FillPlanesFunc fill=get_fill_planes(job->src_pixfmt);
+	WritePlanesFunc write=get_write_planes(job->dst_pixfmt);
+	int64_t period=(int64_t)(1000000/fps);
+	//Moving average of the conversion time per level, 0 if never run or out
+	//of date, and the frame it was last updated on
+	double cost[NB_QUALITY_LEVELS]={0};
+	int cost_frame[NB_QUALITY_LEVELS]={0};
+	int level=0,top=0,hold=0,ret=0;
+	int64_t deadline;
+	FILE *src_file=NULL,*dst_file=NULL;
+	uint8_t *temp_buffer=NULL;
+	FrameBuffer src,dst;
+	struct SwsContext *ctx=NULL;
+	SwsCacheKey key;
+
+	frame_buffer_init(&src);
+	frame_buffer_init(&dst);
+	//The job's scaler is the best quality allowed (see check_quality_levels())
+	for(int i=0;i<NB_QUALITY_LEVELS;i++){
+		if(quality_levels[i]==job->flags)
+			top=level=i;
+	}
+	sws_cache_key_init(&key,job->src_w,job->src_h,job->src_pixfmt,job->dst_w,job->dst_h,job->dst_pixfmt);
+	key.flags=quality_levels[level];
+
+	temp_buffer=(uint8_t *)malloc(src_size);
+	if(!temp_buffer||frame_buffer_ensure(&src,job->src_w,job->src_h,job->src_pixfmt)<0||
+		frame_buffer_ensure(&dst,job->dst_w,job->dst_h,job->dst_pixfmt)<0){
+		printf("Could not allocate image\n");
+		ret=-1;
+		goto end;
+	}
+	src_file=fopen(job->input,"rb");
+	dst_file=fopen(job->output,"wb");
+	if(!src_file||!dst_file){
+		printf("Could not open %s or %s\n",job->input,job->output);
+		ret=-1;
+		goto end;
+	}
+	ctx=sws_cache_acquire(cache,&key);
+	if(!ctx){
+		printf("Could not initialize context\n");
+		ret=-1;
+		goto end;
+	}
+
+	printf("Real-time: %s -> %s at %.2f fps (budget %.2f ms), starting with %s\n",
+		job->input,job->output,fps,period/1000.0,sws_flags_name(quality_levels[level]));
+	deadline=av_gettime()+period;
+	while(1){
+		PROBE_FRAME_START(job_idx,rs->frames);
+		PROBE_IO_SUBMIT(PROBE_IO_READ);
+		size_t n=fread(temp_buffer,1,src_size,src_file);
+		PROBE_IO_COMPLETE(PROBE_IO_READ,(int64_t)n);
+		if(n!=(size_t)src_size){
+			if(n>0||ferror(src_file)){
+				printf("%s: truncated frame %d\n",job->input,rs->frames);
+				ret=-1;
+			}
+			PROBE_FRAME_END(job_idx,rs->frames,ret<0?-1:1);
+			break;
+		}
+		fill(src.data,temp_buffer,job->src_w,job->src_h);
+		int64_t start=av_gettime();
+		PROBE_SCALE_START(ctx,job->src_h);
+		sws_scale(ctx,src.data,src.linesize,0,job->src_h,dst.data,dst.linesize);
+		PROBE_SCALE_END(ctx,job->src_h);
+		int64_t used=av_gettime()-start;
+		cost[level]=cost[level]?cost[level]*0.75+used*0.25:used;
+		cost_frame[level]=rs->frames;
+		PROBE_IO_SUBMIT(PROBE_IO_WRITE);
+		int write_ret=write(dst_file,dst.data,job->dst_w,job->dst_h);
+		PROBE_IO_COMPLETE(PROBE_IO_WRITE,write_ret);
+		if(write_ret<0){
+			printf("%s: write error\n",job->output);
+			PROBE_FRAME_END(job_idx,rs->frames,-1);
+			ret=-1;
+			break;
+		}
+		PROBE_FRAME_END(job_idx,rs->frames,0);
+		rs->level_frames[level]++;
+		rs->frames++;
+
+		int64_t now=av_gettime();
+		int next=level,missed=now>deadline;
+		if(missed){
+			printf("Frame %d: deadline missed by %.2f ms (%s, %.2f ms to scale)\n",
+				rs->frames-1,(now-deadline)/1000.0,sws_flags_name(quality_levels[level]),used/1000.0);
+			rs->missed++;
+			//Live output: drop the backlog instead of rushing the next frames
+			deadline=now;
+		}
+		if(hold>0)
+			hold--;
+		//The cost of a better level was measured under the load that made
+		//us leave it. Forget it after a while so that the level is tried
+		//again; if it is still too slow, the next frame steps back down.
+		for(int i=0;i<NB_QUALITY_LEVELS;i++){
+			if(i!=level&&rs->frames-cost_frame[i]>HOLD_FRAMES)
+				cost[i]=0;
+		}
+		if((missed||cost[level]>period*BUDGET_HIGH)&&level<NB_QUALITY_LEVELS-1){
+			next=level+1;
+		}else if(hold==0&&level>top&&cost[level]<period*BUDGET_LOW&&
+			(!cost[level-1]||cost[level-1]<period*BUDGET_HIGH)){
+			next=level-1;
+		}
+		if(next!=level){
+			SwsCacheStats before,after;
+			sws_cache_get_stats(cache,&before);
+			sws_cache_release(cache,ctx);
+			key.flags=quality_levels[next];
+			ctx=sws_cache_acquire(cache,&key);
+			if(!ctx){
+				printf("Could not initialize context\n");
+				ret=-1;
+				break;
+			}
+			sws_cache_get_stats(cache,&after);
+			printf("Frame %d: %s -> %s (avg %.2f ms to scale, budget %.2f ms%s)\n",
+				rs->frames-1,sws_flags_name(quality_levels[level]),sws_flags_name(quality_levels[next]),
+				cost[level]/1000.0,period/1000.0,after.misses>before.misses?", new context":"");
+			level=next;
+			hold=HOLD_FRAMES;
+			rs->switches++;
+		}
+
+		now=av_gettime();
+		if(deadline>now)
+			av_usleep((unsigned)(deadline-now));
+		deadline+=period;
+	}
+
+end:
+	if(ctx)
+		sws_cache_release(cache,ctx);
+	if(src_file)
+		fclose(src_file);
+	if(dst_file&&fclose(dst_file)!=0){
+		printf("%s: write error\n",job->output);
+		ret=-1;
+	}
+	frame_buffer_free(&src);
+	frame_buffer_free(&dst);
+	free(temp_buffer);
+	return ret;
+}
+
+//Jobs must ask for one of the quality levels: a real-time job with another
+//scaler would silently be run with bicubic
+static int check_quality_levels(const JobSpec *jobs,int nb_jobs)
+{
+	for(int i=0;i<nb_jobs;i++){
+		int found=0;
+		for(int k=0;k<NB_QUALITY_LEVELS;k++)
+			found|=quality_levels[k]==jobs[i].flags;
+		if(!found){
+			printf("Job %d: real-time mode supports bicubic, bilinear and fast_bilinear, not %s\n",
+				i,sws_flags_name(jobs[i].flags));
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int realtime_main(const char *manifest,double fps)
+{
+	JobSpec *jobs=NULL;
+	SwsCache *cache;
+	int nb_jobs,failed=0;
+
+	if(!(fps>0)){
+		printf("Invalid frame rate\n");
+		return -1;
+	}
+	nb_jobs=read_manifest(manifest,&jobs);
+	if(nb_jobs<0)
+		return -1;
+	if(check_no_pal8(jobs,nb_jobs)<0||check_quality_levels(jobs,nb_jobs)<0){
+		free(jobs);
+		return -1;
+	}
+	//One context per quality level
+	cache=sws_cache_alloc(NB_QUALITY_LEVELS);
+	if(!cache){
+		free(jobs);
+		return -1;
+	}
+	for(int i=0;i<nb_jobs;i++){
+		RealtimeStats rs;
+		memset(&rs,0,sizeof(rs));
+		if(run_realtime_job(&jobs[i],i,cache,fps,&rs)<0)
+			failed++;
+		printf("Job %5d: %d frames, %d deadlines missed, %d switches (",i,rs.frames,rs.missed,rs.switches);
+		for(int k=0;k<NB_QUALITY_LEVELS;k++)
+			printf("%s%s %d",k?", ":"",sws_flags_name(quality_levels[k]),rs.level_frames[k]);
+		printf(")\n");
+	}
+	sws_cache_free(&cache);
+	free(jobs);
+	return failed?1:0;
+}
@@ -0,0 +1,18 @@
+/**
+ * Real-time mode: convert at a fixed frame rate for live outputs
+ *
+ * Frames are paced to their deadlines (one every 1/fps second). When
+ * conversion uses up too much of the per-frame budget the scaler steps down
+ * to a cheaper algorithm (bicubic -> bilinear -> fast bilinear), and back up
+ * once there is headroom again: a softer frame is better than a late one.
+ * The manifest's scaler is the best level a job may use, so it must be one
+ * of these three.
+ */
+
+#ifndef REALTIME_H
+#define REALTIME_H
+
+//Run the manifest jobs (see batch.h) one after another at fps
+int realtime_main(const char *manifest,double fps);
+
+#endif
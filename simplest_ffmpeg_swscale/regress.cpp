@@ -0,0 +1,291 @@
+/**
+ * Performance regression gate
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+extern "C"
+{
+#include "libavutil/pixdesc.h"
+#include "libavutil/time.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libavutil/pixdesc.h>
+#include <libavutil/time.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+#include "regress.h"
+#include "pattern_source.h"
+#include "mem_report.h"
+#include "batch.h"
+
+typedef struct RegressScenario{
+	AVPixelFormat src_pixfmt;
+	int src_w,src_h;
+	AVPixelFormat dst_pixfmt;
+	int dst_w,dst_h;
+	int flags;
+}RegressScenario;
+
+//The conversions the converter is deployed for, one per resolution tier
+static const RegressScenario scenarios[]={
+	{AV_PIX_FMT_YUV420P,1280,720,AV_PIX_FMT_RGB24,640,360,SWS_FAST_BILINEAR},
+	{AV_PIX_FMT_YUV420P,1920,1080,AV_PIX_FMT_YUV420P,1280,720,SWS_BICUBIC},
+	{AV_PIX_FMT_YUV420P,1920,1080,AV_PIX_FMT_RGB24,1920,1080,SWS_BILINEAR},
+	{AV_PIX_FMT_RGB24,1280,720,AV_PIX_FMT_YUV420P,1280,720,SWS_BICUBIC},
+	{AV_PIX_FMT_YUV420P,3840,2160,AV_PIX_FMT_YUV420P,1920,1080,SWS_BICUBIC}
+};
+static const int nb_scenarios=sizeof(scenarios)/sizeof(scenarios[0]);
+
+//Source pixels per trial, so that every scenario takes about as long, but
+//enough frames for the 99th percentile not to be just the slowest one
+#define REGRESS_PIXELS 100000000
+#define REGRESS_MIN_FRAMES 100
+#define REGRESS_CACHED_FRAMES 8
+
+#define REGRESS_VERSION 2
+#define REGRESS_NAME_SIZE 128
+
+typedef struct RegressResult{
+	char name[REGRESS_NAME_SIZE];
+	double fps;             //Medians over the trials
+	double p99_ms;
+	int64_t peak_bytes;     //Growth of the resident set during setup and trials, -1 if not known
+	double fps_min,fps_max;
+}RegressResult;
+
+static void scenario_name(const RegressScenario *s,char *name)
+{
+	snprintf(name,REGRESS_NAME_SIZE,"%s %dx%d -> %s %dx%d %s",
+		av_get_pix_fmt_name(s->src_pixfmt),s->src_w,s->src_h,
+		av_get_pix_fmt_name(s->dst_pixfmt),s->dst_w,s->dst_h,sws_flags_name(s->flags));
+}
+
+static double median(std::vector<double> v)
+{
+	std::sort(v.begin(),v.end());
+	size_t n=v.size();
+	return n%2?v[n/2]:(v[n/2-1]+v[n/2])/2;
+}
+
+//One pass over nb_frames frames. latency must hold nb_frames entries.
+static int run_trial(PatternSource &source,Scaler &scaler,Frame &src,Frame &dst,
+					 std::vector<int64_t> &latency,double *fps,double *p99_ms)
+{
+	NullSink sink;
+	int nb_frames=(int)latency.size();
+	source.rewind();
+	int64_t start=av_gettime();
+	for(int i=0;i<nb_frames;i++){
+		int64_t frame_start=av_gettime();
+		if(source.read(src)!=1||scaler.scale(src,dst)<0||sink.write(dst)<0)
+			return -1;
+		latency[i]=av_gettime()-frame_start;
+	}
+	int64_t time=av_gettime()-start;
+	*fps=time>0?nb_frames*1e6/time:0;
+	//Smallest latency that 99% of the frames do not exceed
+	std::sort(latency.begin(),latency.end());
+	*p99_ms=latency[(nb_frames*99+99)/100-1]/1000.0;
+	return 0;
+}
+
+static int run_scenario(const RegressScenario *s,int trials,RegressResult *result)
+{
+	PatternSpec spec;
+	PatternSource source;
+	Scaler scaler;
+	Frame src,dst;
+	int nb_frames=std::max(REGRESS_MIN_FRAMES,(int)(REGRESS_PIXELS/((int64_t)s->src_w*s->src_h)));
+	std::vector<int64_t> latency(nb_frames);
+	std::vector<double> fps(trials),p99(trials);
+
+	memset(result,0,sizeof(*result));
+	scenario_name(s,result->name);
+	pattern_preset(&spec,"movingbars");
+	if(source.open(spec,s->src_w,s->src_h,s->src_pixfmt,REGRESS_CACHED_FRAMES,nb_frames)<0){
+		printf("%s: could not draw the source frames\n",result->name);
+		return -1;
+	}
+	//What the conversion needs at its peak: frames, scaler setup and
+	//whatever libswscale allocates while scaling, not the source frames
+	//drawn above
+	int64_t rss_before=mem_reset_rss_high_water()<0?-1:mem_current_rss();
+	if(src.alloc(s->src_w,s->src_h,s->src_pixfmt)<0||dst.alloc(s->dst_w,s->dst_h,s->dst_pixfmt)<0||
+		scaler.init(s->src_w,s->src_h,s->src_pixfmt,s->dst_w,s->dst_h,s->dst_pixfmt,s->flags)<0){
+		printf("%s: could not set up the conversion\n",result->name);
+		return -1;
+	}
+	//The first call sets up the scaler's internal buffers, keep it out of the timing
+	if(scaler.scale(source.cached(0),dst)<0)
+		return -1;
+
+	for(int t=0;t<trials;t++){
+		if(run_trial(source,scaler,src,dst,latency,&fps[t],&p99[t])<0){
+			printf("%s: conversion failed\n",result->name);
+			return -1;
+		}
+	}
+	result->fps=median(fps);
+	result->p99_ms=median(p99);
+	result->fps_min=*std::min_element(fps.begin(),fps.end());
+	result->fps_max=*std::max_element(fps.begin(),fps.end());
+	int64_t rss_peak=mem_rss_high_water();
+	result->peak_bytes=rss_before>=0&&rss_peak>=0?std::max(rss_peak-rss_before,(int64_t)0):-1;
+	return 0;
+}
+
+//One scenario per line, so that load_baseline() can read it back line by line
+static int save_baseline(const char *path,const std::vector<RegressResult> &results,int trials)
+{
+	FILE *fp=fopen(path,"w");
+	if(!fp){
+		printf("Could not open %s\n",path);
+		return -1;
+	}
+	fprintf(fp,"{\"version\":%d,\"trials\":%d,\"scenarios\":[\n",REGRESS_VERSION,trials);
+	for(size_t i=0;i<results.size();i++){
+		const RegressResult *r=&results[i];
+		fprintf(fp,"{\"name\":\"%s\",\"fps\":%.3f,\"p99_ms\":%.4f,\"peak_bytes\":%lld,\"fps_min\":%.3f,\"fps_max\":%.3f}%s\n",
+			r->name,r->fps,r->p99_ms,(long long)r->peak_bytes,r->fps_min,r->fps_max,
+			i+1<results.size()?",":"");
+	}
+	fprintf(fp,"]}\n");
+	if(fclose(fp)!=0){
+		printf("Could not write %s\n",path);
+		return -1;
+	}
+	return 0;
+}
+
+//Reads the files save_baseline() writes, not JSON in general
+static int load_baseline(const char *path,std::vector<RegressResult> *baseline)
+{
+	char line[512];
+	int version=0;
+	FILE *fp=fopen(path,"r");
+	if(!fp){
+		printf("Could not open %s\n",path);
+		return -1;
+	}
+	baseline->clear();
+	if(!fgets(line,sizeof(line),fp)||sscanf(line,"{\"version\":%d",&version)!=1||
+		version!=REGRESS_VERSION){
+		printf("%s is not a baseline of this version, record it again\n",path);
+		fclose(fp);
+		return -1;
+	}
+	while(fgets(line,sizeof(line),fp)){
+		RegressResult r;
+		long long peak_bytes;
+		memset(&r,0,sizeof(r));
+		if(sscanf(line,"{\"name\":\"%127[^\"]\",\"fps\":%lf,\"p99_ms\":%lf,\"peak_bytes\":%lld",
+			r.name,&r.fps,&r.p99_ms,&peak_bytes)!=4)
+			continue;
+		r.peak_bytes=peak_bytes;
+		baseline->push_back(r);
+	}
+	fclose(fp);
+	return 0;
+}
+
+static const RegressResult *find_result(const std::vector<RegressResult> &baseline,const char *name)
+{
+	for(size_t i=0;i<baseline.size();i++){
+		if(strcmp(baseline[i].name,name)==0)
+			return &baseline[i];
+	}
+	return NULL;
+}
+
+//Change against the baseline in percent
+static double change(double now,double base)
+{
+	return base>0?(now-base)*100/base:0;
+}
+
+static void print_mib(int64_t bytes)
+{
+	if(bytes<0)
+		printf(" %8s","n/a");
+	else
+		printf(" %8.1f",bytes/(1024.0*1024.0));
+}
+
+int regress_main(const char *mode,const char *path,int trials,double tolerance,double mem_tolerance)
+{
+	std::vector<RegressResult> baseline,results;
+	int record=strcmp(mode,"record")==0;
+	int regressions=0,noisy=0;
+
+	if(!record&&strcmp(mode,"check")!=0){
+		printf("Unknown mode %s, use record or check\n",mode);
+		return -1;
+	}
+	if(trials<1||tolerance<0||mem_tolerance<0){
+		printf("Trials must be positive and tolerances not negative\n");
+		return -1;
+	}
+	if(!record&&load_baseline(path,&baseline)<0)
+		return -1;
+
+	printf("%d scenarios, %d trials each%s\n",nb_scenarios,trials,record?"":", change against the baseline");
+	printf("%-48s %9s %7s %9s %7s %8s\n","scenario","fps","","p99 ms","","MiB");
+	for(int i=0;i<nb_scenarios;i++){
+		RegressResult r;
+		if(run_scenario(&scenarios[i],trials,&r)<0)
+			return -1;
+		results.push_back(r);
+		printf("%-48s %9.1f",r.name,r.fps);
+		const RegressResult *base=record?NULL:find_result(baseline,r.name);
+		if(!base){
+			printf(" %7s %9.3f %7s","",r.p99_ms,"");
+			print_mib(r.peak_bytes);
+			printf("%s\n",record?"":"          not in baseline");
+			continue;
+		}
+		//Memory is compared where both runs could measure it
+		int mem_known=r.peak_bytes>=0&&base->peak_bytes>=0;
+		int slower=r.fps<base->fps*(1-tolerance/100)||r.p99_ms>base->p99_ms*(1+tolerance/100);
+		int bigger=mem_known&&r.peak_bytes>base->peak_bytes*(1+mem_tolerance/100);
+		int spread=r.fps>0&&(r.fps_max-r.fps_min)*100/r.fps>tolerance;
+		printf(" %+6.1f%% %9.3f %+6.1f%%",change(r.fps,base->fps),r.p99_ms,change(r.p99_ms,base->p99_ms));
+		print_mib(r.peak_bytes);
+		if(mem_known)
+			printf(" %+6.1f%%",change((double)r.peak_bytes,(double)base->peak_bytes));
+		else
+			printf(" %7s","");
+		printf("  %s%s\n",slower&&bigger?"SLOWER, MEMORY":slower?"SLOWER":bigger?"MEMORY":"OK",spread?" (noisy)":"");
+		regressions+=slower||bigger;
+		noisy+=spread;
+	}
+
+	if(record){
+		if(save_baseline(path,results,trials)<0)
+			return -1;
+		printf("Baseline written to %s\n",path);
+		return 0;
+	}
+	if(noisy)
+		printf("%d scenarios spread more than %.1f%% between trials: run more trials or on a quieter machine\n",
+			noisy,tolerance);
+	printf("%d of %d scenarios regressed (tolerance %.1f%%, memory %.1f%%)\n",
+		regressions,nb_scenarios,tolerance,mem_tolerance);
+	return regressions?1:0;
+}
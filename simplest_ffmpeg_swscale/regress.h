@@ -0,0 +1,32 @@
+/**
+ * Performance regression gate
+ *
+ * Runs a fixed set of conversions on generated frames (see
+ * pattern_source.h) a number of times and keeps, per scenario, the median
+ * over the trials of the throughput and of the 99th percentile of the frame
+ * latency (read, scale and write) over at least 100 frames per trial, and
+ * its peak memory: how far the resident set grew from before the frames
+ * and the scaler were set up until the last trial (Linux, see
+ * mem_rss_high_water(); n/a and not compared elsewhere):
+ *
+ *   simplest_ffmpeg_swscale -regress record baseline.json [trials]
+ *   simplest_ffmpeg_swscale -regress check baseline.json [trials [tolerance% [mem_tolerance%]]]
+ *
+ * check compares against the baseline and returns 1 if any scenario is
+ * slower (fps lower or p99 higher) by more than tolerance, 10% by default,
+ * or holds more memory than mem_tolerance, 5% by default, allows, so a
+ * build script can stop an swscale upgrade or a converter change that
+ * costs speed. Medians keep one disturbed trial from deciding; when the
+ * trials of a scenario spread more than the tolerance the result is marked
+ * noisy, and more trials or a quieter machine are needed.
+ *
+ * Record the baseline on the machine the checks run on.
+ */
+
+#ifndef REGRESS_H
+#define REGRESS_H
+
+//mode: "record" or "check". Returns 0, 1 on a regression, <0 on error.
+int regress_main(const char *mode,const char *path,int trials,double tolerance,double mem_tolerance);
+
+#endif
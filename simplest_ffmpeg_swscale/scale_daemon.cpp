@@ -0,0 +1,545 @@
+/**
+ * Scaling daemon: one process serves the conversions of many local clients
+ *
+ * Every connection has a reader thread that receives requests and queues
+ * them on the shared pool. A connection is torn down by its reader once the
+ * client has hung up and no request of it is left in the pool.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+extern "C"
+{
+#include "libswscale/swscale.h"
+#include "libavutil/imgutils.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libswscale/swscale.h>
+#include <libavutil/imgutils.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+#include "scale_daemon.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+#include "batch.h"
+#include "frame_io.h"
+#include "sws_cache.h"
+#include "thread_pool.h"
+#include "probes.h"
+
+//Requests of one connection queued or running at a time. The reader stops
+//taking more until one finishes, so a client cannot fill the shared pool
+//(and the daemon's descriptor table) on its own.
+#define MAX_IN_FLIGHT 16
+
+typedef struct DaemonConn{
+	int fd;
+	std::mutex lock;          //Serializes replies, guards in_flight
+	std::condition_variable done_cond;    //A request finished
+	int in_flight;
+}DaemonConn;
+
+typedef struct Daemon{
+	SwsCache *cache;
+	ThreadPool *pool;
+	std::mutex lock;          //Guards conns
+	std::condition_variable conns_cond;
+	std::vector<DaemonConn *> conns;
+}Daemon;
+
+typedef struct DaemonTask{
+	Daemon *daemon;
+	DaemonConn *conn;
+	ScaleRequest req;
+	int src_fd,dst_fd;
+}DaemonTask;
+
+static volatile sig_atomic_t daemon_exit=0;
+
+static void daemon_signal(int sig)
+{
+	daemon_exit=1;
+}
+
+static int check_request(const ScaleRequest *req)
+{
+	if(req->magic!=SCALE_DAEMON_MAGIC)
+		return -1;
+	if(!is_supported_pixfmt((AVPixelFormat)req->src_pixfmt)||
+		!is_supported_pixfmt((AVPixelFormat)req->dst_pixfmt))
+		return -1;
+	if(check_frame_size((AVPixelFormat)req->src_pixfmt,req->src_w,req->src_h)<0||
+		check_frame_size((AVPixelFormat)req->dst_pixfmt,req->dst_w,req->dst_h)<0)
+		return -1;
+	if(strcmp(sws_flags_name(req->flags),"unknown")==0)
+		return -1;
+	return 0;
+}
+
+//Map a frame of the given size from fd, NULL if the file is too small or
+//may shrink: a client truncating it during the scale would get the daemon
+//killed by SIGBUS, with the jobs of every other client
+static uint8_t *map_frame(int fd,int size,int prot)
+{
+	struct stat st;
+	void *p;
+	int seals=fcntl(fd,F_GET_SEALS);
+	if(seals<0||!(seals&F_SEAL_SHRINK))
+		return NULL;
+	if(fstat(fd,&st)<0||st.st_size<size)
+		return NULL;
+	p=mmap(NULL,size,prot,MAP_SHARED,fd,0);
+	return p==MAP_FAILED?NULL:(uint8_t *)p;
+}
+
+static int scale_request(SwsCache *cache,const ScaleRequest *req,int src_fd,int dst_fd)
+{
+	AVPixelFormat src_pixfmt=(AVPixelFormat)req->src_pixfmt;
+	AVPixelFormat dst_pixfmt=(AVPixelFormat)req->dst_pixfmt;
+	int src_size,dst_size,ret=-1;
+	uint8_t *src_map=NULL,*dst_map=NULL;
+	uint8_t *src_data[4],*dst_data[4];
+	int src_linesize[4],dst_linesize[4];
+	struct SwsContext *ctx=NULL;
+	SwsCacheKey key;
+
+	if(check_request(req)<0)
+		return -1;
+	src_size=raw_frame_size(src_pixfmt,req->src_w,req->src_h);
+	dst_size=raw_frame_size(dst_pixfmt,req->dst_w,req->dst_h);
+	src_map=map_frame(src_fd,src_size,PROT_READ);
+	dst_map=map_frame(dst_fd,dst_size,PROT_READ|PROT_WRITE);
+	if(!src_map||!dst_map)
+		goto end;
+	//Planes point into the client's memory, nothing is copied
+	av_image_fill_arrays(src_data,src_linesize,src_map,src_pixfmt,req->src_w,req->src_h,1);
+	av_image_fill_arrays(dst_data,dst_linesize,dst_map,dst_pixfmt,req->dst_w,req->dst_h,1);
+
+	sws_cache_key_init(&key,req->src_w,req->src_h,src_pixfmt,req->dst_w,req->dst_h,dst_pixfmt);
+	key.flags=req->flags;
+	ctx=sws_cache_acquire(cache,&key);
+	if(!ctx)
+		goto end;
+	PROBE_SCALE_START(ctx,req->src_h);
+	sws_scale(ctx,src_data,src_linesize,0,req->src_h,dst_data,dst_linesize);
+	PROBE_SCALE_END(ctx,req->src_h);
+	sws_cache_release(cache,ctx);
+	ret=0;
+
+end:
+	if(src_map)
+		munmap(src_map,src_size);
+	if(dst_map)
+		munmap(dst_map,dst_size);
+	return ret;
+}
+
+static void run_task(void *arg,int worker_idx)
+{
+	DaemonTask *task=(DaemonTask *)arg;
+	DaemonConn *conn=task->conn;
+	ScaleReply reply;
+
+	memset(&reply,0,sizeof(reply));
+	reply.id=task->req.id;
+	reply.status=scale_request(task->daemon->cache,&task->req,task->src_fd,task->dst_fd);
+	close(task->src_fd);
+	close(task->dst_fd);
+
+	std::lock_guard<std::mutex> guard(conn->lock);
+	//A client that went away only loses its reply
+	send(conn->fd,&reply,sizeof(reply),MSG_NOSIGNAL);
+	conn->in_flight--;
+	conn->done_cond.notify_all();
+	delete task;
+}
+
+//Receive one request and its two descriptors. 0 at end of stream.
+static int recv_request(int sock,ScaleRequest *req,int fds[2])
+{
+	union{
+		char buf[CMSG_SPACE(2*sizeof(int))];
+		struct cmsghdr align;
+	}control;
+	struct iovec iov;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	int nb_fds=0;
+	ssize_t n;
+
+	iov.iov_base=req;
+	iov.iov_len=sizeof(*req);
+	memset(&msg,0,sizeof(msg));
+	msg.msg_iov=&iov;
+	msg.msg_iovlen=1;
+	msg.msg_control=control.buf;
+	msg.msg_controllen=sizeof(control.buf);
+	do{
+		n=recvmsg(sock,&msg,MSG_CMSG_CLOEXEC);
+	}while(n<0&&errno==EINTR);
+	if(n<=0)
+		return n<0?-1:0;
+
+	fds[0]=fds[1]=-1;
+	for(cmsg=CMSG_FIRSTHDR(&msg);cmsg;cmsg=CMSG_NXTHDR(&msg,cmsg)){
+		if(cmsg->cmsg_level!=SOL_SOCKET||cmsg->cmsg_type!=SCM_RIGHTS)
+			continue;
+		int count=(cmsg->cmsg_len-CMSG_LEN(0))/sizeof(int);
+		int *p=(int *)CMSG_DATA(cmsg);
+		for(int i=0;i<count;i++){
+			if(nb_fds<2)
+				fds[nb_fds++]=p[i];
+			else
+				close(p[i]);
+		}
+	}
+	if(n!=sizeof(*req)||nb_fds!=2||(msg.msg_flags&MSG_CTRUNC)){
+		if(fds[0]>=0)
+			close(fds[0]);
+		if(fds[1]>=0)
+			close(fds[1]);
+		return -1;
+	}
+	return 1;
+}
+
+static void conn_thread(Daemon *daemon,DaemonConn *conn)
+{
+	while(1){
+		ScaleRequest req;
+		int fds[2];
+		int ret=recv_request(conn->fd,&req,fds);
+		if(ret==0)
+			break;
+		if(ret<0){
+			printf("Client %d: malformed request, closing\n",conn->fd);
+			break;
+		}
+		DaemonTask *task=new DaemonTask;
+		task->daemon=daemon;
+		task->conn=conn;
+		task->req=req;
+		task->src_fd=fds[0];
+		task->dst_fd=fds[1];
+		{
+			std::lock_guard<std::mutex> guard(conn->lock);
+			conn->in_flight++;
+		}
+		thread_pool_submit(daemon->pool,run_task,task);
+		//Not reading leaves the next requests in the socket, the client blocks
+		{
+			std::unique_lock<std::mutex> guard(conn->lock);
+			while(conn->in_flight>=MAX_IN_FLIGHT)
+				conn->done_cond.wait(guard);
+		}
+	}
+
+	//The tasks still queued reply on this connection
+	{
+		std::unique_lock<std::mutex> guard(conn->lock);
+		while(conn->in_flight)
+			conn->done_cond.wait(guard);
+	}
+	std::lock_guard<std::mutex> guard(daemon->lock);
+	daemon->conns.erase(std::find(daemon->conns.begin(),daemon->conns.end(),conn));
+	close(conn->fd);
+	delete conn;
+	daemon->conns_cond.notify_all();
+}
+
+int scale_daemon_main(const char *socket_path,int nb_threads)
+{
+	Daemon daemon;
+	struct sockaddr_un addr;
+	struct sigaction sa;
+	int listen_fd,ret=-1;
+
+	if(strlen(socket_path)>=sizeof(addr.sun_path)){
+		printf("Socket path too long: %s\n",socket_path);
+		return -1;
+	}
+	memset(&addr,0,sizeof(addr));
+	addr.sun_family=AF_UNIX;
+	strcpy(addr.sun_path,socket_path);
+	listen_fd=socket(AF_UNIX,SOCK_SEQPACKET|SOCK_CLOEXEC,0);
+	if(listen_fd<0){
+		printf("Could not create socket\n");
+		return -1;
+	}
+	unlink(socket_path);
+	if(bind(listen_fd,(struct sockaddr *)&addr,sizeof(addr))<0||listen(listen_fd,16)<0){
+		printf("Could not listen on %s\n",socket_path);
+		close(listen_fd);
+		return -1;
+	}
+
+	daemon.pool=thread_pool_alloc(nb_threads);
+	nb_threads=thread_pool_size(daemon.pool);
+	daemon.cache=sws_cache_alloc(nb_threads*4);
+	if(!daemon.cache){
+		printf("Could not allocate context cache\n");
+		goto end;
+	}
+
+	//No SA_RESTART: the signal must break accept()
+	memset(&sa,0,sizeof(sa));
+	sa.sa_handler=daemon_signal;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT,&sa,NULL);
+	sigaction(SIGTERM,&sa,NULL);
+
+	printf("Daemon: listening on %s, %d threads\n",socket_path,nb_threads);
+	fflush(stdout);
+	while(!daemon_exit){
+		int fd=accept4(listen_fd,NULL,NULL,SOCK_CLOEXEC);
+		if(fd<0){
+			if(errno==EINTR||errno==ECONNABORTED)
+				continue;
+			printf("accept() failed\n");
+			break;
+		}
+		DaemonConn *conn=new DaemonConn;
+		conn->fd=fd;
+		conn->in_flight=0;
+		std::lock_guard<std::mutex> guard(daemon.lock);
+		daemon.conns.push_back(conn);
+		std::thread(conn_thread,&daemon,conn).detach();
+	}
+	ret=0;
+
+	{
+		//Wake the readers, they drain their requests and go away
+		std::unique_lock<std::mutex> guard(daemon.lock);
+		for(size_t i=0;i<daemon.conns.size();i++)
+			shutdown(daemon.conns[i]->fd,SHUT_RD);
+		while(!daemon.conns.empty())
+			daemon.conns_cond.wait(guard);
+	}
+	{
+		SwsCacheStats stats;
+		sws_cache_get_stats(daemon.cache,&stats);
+		printf("Daemon: exiting. SwsContext cache: %lld hits, %lld misses, hit rate %.1f%%\n",
+			(long long)stats.hits,(long long)stats.misses,sws_cache_hit_rate(&stats)*100);
+	}
+
+end:
+	thread_pool_free(&daemon.pool);
+	sws_cache_free(&daemon.cache);
+	close(listen_fd);
+	unlink(socket_path);
+	return ret;
+}
+
+int scale_daemon_connect(const char *socket_path)
+{
+	struct sockaddr_un addr;
+	int fd;
+	if(strlen(socket_path)>=sizeof(addr.sun_path))
+		return -1;
+	memset(&addr,0,sizeof(addr));
+	addr.sun_family=AF_UNIX;
+	strcpy(addr.sun_path,socket_path);
+	fd=socket(AF_UNIX,SOCK_SEQPACKET|SOCK_CLOEXEC,0);
+	if(fd<0)
+		return -1;
+	if(connect(fd,(struct sockaddr *)&addr,sizeof(addr))<0){
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int scale_daemon_scale(int sock,const ScaleRequest *req,int src_fd,int dst_fd)
+{
+	union{
+		char buf[CMSG_SPACE(2*sizeof(int))];
+		struct cmsghdr align;
+	}control;
+	struct iovec iov;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	ScaleReply reply;
+	ssize_t n;
+
+	iov.iov_base=(void *)req;
+	iov.iov_len=sizeof(*req);
+	memset(&msg,0,sizeof(msg));
+	memset(&control,0,sizeof(control));
+	msg.msg_iov=&iov;
+	msg.msg_iovlen=1;
+	msg.msg_control=control.buf;
+	msg.msg_controllen=sizeof(control.buf);
+	cmsg=CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level=SOL_SOCKET;
+	cmsg->cmsg_type=SCM_RIGHTS;
+	cmsg->cmsg_len=CMSG_LEN(2*sizeof(int));
+	((int *)CMSG_DATA(cmsg))[0]=src_fd;
+	((int *)CMSG_DATA(cmsg))[1]=dst_fd;
+	if(sendmsg(sock,&msg,MSG_NOSIGNAL)!=(ssize_t)sizeof(*req))
+		return -1;
+	do{
+		n=recv(sock,&reply,sizeof(reply),0);
+	}while(n<0&&errno==EINTR);
+	if(n!=sizeof(reply)||reply.id!=req->id)
+		return -1;
+	return reply.status;
+}
+
+static int run_client_job(int sock,const JobSpec *job,uint64_t *id)
+{
+	int src_size=raw_frame_size(job->src_pixfmt,job->src_w,job->src_h);
+	int dst_size=raw_frame_size(job->dst_pixfmt,job->dst_w,job->dst_h);
+	int src_fd=-1,dst_fd=-1,frames=0,ret=-1;
+	uint8_t *src_map=NULL,*dst_map=NULL;
+	FILE *src_file=NULL,*dst_file=NULL;
+	ScaleRequest req;
+
+	memset(&req,0,sizeof(req));
+	req.magic=SCALE_DAEMON_MAGIC;
+	req.flags=job->flags;
+	req.src_w=job->src_w;
+	req.src_h=job->src_h;
+	req.src_pixfmt=job->src_pixfmt;
+	req.dst_w=job->dst_w;
+	req.dst_h=job->dst_h;
+	req.dst_pixfmt=job->dst_pixfmt;
+
+	//Sealed against shrinking, as the daemon requires
+	src_fd=memfd_create("scale_src",MFD_CLOEXEC|MFD_ALLOW_SEALING);
+	dst_fd=memfd_create("scale_dst",MFD_CLOEXEC|MFD_ALLOW_SEALING);
+	if(src_fd<0||dst_fd<0||ftruncate(src_fd,src_size)<0||ftruncate(dst_fd,dst_size)<0||
+		fcntl(src_fd,F_ADD_SEALS,F_SEAL_SHRINK)<0||fcntl(dst_fd,F_ADD_SEALS,F_SEAL_SHRINK)<0){
+		printf("Could not create frame memory\n");
+		goto end;
+	}
+	src_map=(uint8_t *)mmap(NULL,src_size,PROT_READ|PROT_WRITE,MAP_SHARED,src_fd,0);
+	dst_map=(uint8_t *)mmap(NULL,dst_size,PROT_READ,MAP_SHARED,dst_fd,0);
+	if(src_map==MAP_FAILED||dst_map==MAP_FAILED){
+		printf("Could not map frame memory\n");
+		goto end;
+	}
+	src_file=fopen(job->input,"rb");
+	dst_file=fopen(job->output,"wb");
+	if(!src_file||!dst_file){
+		printf("Could not open %s or %s\n",job->input,job->output);
+		goto end;
+	}
+
+	//Frames are read straight into the shared memory
+	while(fread(src_map,1,src_size,src_file)==(size_t)src_size){
+		req.id=(*id)++;
+		if(scale_daemon_scale(sock,&req,src_fd,dst_fd)<0){
+			printf("%s: frame %d failed\n",job->input,frames);
+			goto end;
+		}
+		if(fwrite(dst_map,1,dst_size,dst_file)!=(size_t)dst_size){
+			printf("%s: write error\n",job->output);
+			goto end;
+		}
+		frames++;
+	}
+	ret=frames;
+
+end:
+	if(src_map&&src_map!=MAP_FAILED)
+		munmap(src_map,src_size);
+	if(dst_map&&dst_map!=MAP_FAILED)
+		munmap(dst_map,dst_size);
+	if(src_fd>=0)
+		close(src_fd);
+	if(dst_fd>=0)
+		close(dst_fd);
+	if(src_file)
+		fclose(src_file);
+	if(dst_file&&fclose(dst_file)!=0)
+		ret=-1;
+	return ret;
+}
+
+int scale_client_main(const char *socket_path,const char *manifest)
+{
+	JobSpec *jobs=NULL;
+	uint64_t id=0;
+	int nb_jobs,sock,failed=0;
+
+	nb_jobs=read_manifest(manifest,&jobs);
+	if(nb_jobs<0)
+		return -1;
+	if(check_no_pal8(jobs,nb_jobs)<0){
+		free(jobs);
+		return -1;
+	}
+	sock=scale_daemon_connect(socket_path);
+	if(sock<0){
+		printf("Could not connect to %s\n",socket_path);
+		free(jobs);
+		return -1;
+	}
+	for(int i=0;i<nb_jobs;i++){
+		int frames=run_client_job(sock,&jobs[i],&id);
+		if(frames<=0){
+			printf("Job %5d %s -> %s: FAILED\n",i,jobs[i].input,jobs[i].output);
+			failed++;
+			continue;
+		}
+		printf("Job %5d %s -> %s: %d frames\n",i,jobs[i].input,jobs[i].output,frames);
+	}
+	close(sock);
+	free(jobs);
+	return failed?1:0;
+}
+
+#else
+
+int scale_daemon_main(const char *socket_path,int nb_threads)
+{
+	printf("The scaling daemon is only supported on Linux\n");
+	return -1;
+}
+
+int scale_daemon_connect(const char *socket_path)
+{
+	return -1;
+}
+
+int scale_daemon_scale(int sock,const ScaleRequest *req,int src_fd,int dst_fd)
+{
+	return -1;
+}
+
+int scale_client_main(const char *socket_path,const char *manifest)
+{
+	printf("The scaling daemon is only supported on Linux\n");
+	return -1;
+}
+
+#endif
@@ -0,0 +1,51 @@
+/**
+ * Scaling daemon: one process serves the conversions of many local clients
+ *
+ * The daemon listens on a Unix domain socket. A client sends a
+ * ScaleRequest together with two memfd file descriptors (SCM_RIGHTS):
+ * the source frame and the output frame, both laid out as in raw files
+ * (see frame_io.h), the output one already sized by the client. Both must
+ * be sealed with F_SEAL_SHRINK (memfd_create(MFD_ALLOW_SEALING), then
+ * fcntl(F_ADD_SEALS)), other descriptors are refused. The daemon
+ * maps both and scales straight from one into the other, then answers
+ * with a ScaleReply carrying the same id. Requests of all clients share one
+ * SwsContext cache and one worker pool; replies to a client may come back
+ * in any order. A connection has at most 16 requests queued; beyond that
+ * the daemon stops reading from it until one is done.
+ *
+ * Linux only, elsewhere the functions fail.
+ */
+
+#ifndef SCALE_DAEMON_H
+#define SCALE_DAEMON_H
+
+#include <stdint.h>
+
+#define SCALE_DAEMON_MAGIC 0x53434C31   //"SCL1"
+
+typedef struct ScaleRequest{
+	uint32_t magic;
+	uint32_t flags;         //SWS_BICUBIC, SWS_BILINEAR...
+	uint64_t id;            //Echoed in the reply
+	int32_t src_w,src_h,src_pixfmt;
+	int32_t dst_w,dst_h,dst_pixfmt;
+}ScaleRequest;
+
+typedef struct ScaleReply{
+	uint64_t id;
+	int32_t status;         //0 on success, <0 on error
+	int32_t reserved;
+}ScaleReply;
+
+//Serve until SIGINT or SIGTERM. nb_threads<=0: one worker per CPU core
+int scale_daemon_main(const char *socket_path,int nb_threads);
+
+//Client side. Returns the connected socket, <0 on error.
+int scale_daemon_connect(const char *socket_path);
+//Send one request and wait for its reply. Returns the reply status.
+int scale_daemon_scale(int sock,const ScaleRequest *req,int src_fd,int dst_fd);
+
+//-client mode: run the manifest jobs (see batch.h) through a daemon
+int scale_client_main(const char *socket_path,const char *manifest);
+
+#endif
@@ -0,0 +1,292 @@
+/**
+ * Scaling library
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+extern "C"
+{
+#include "libavutil/opt.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libavutil/opt.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+#include "scaler.h"
+#include "alloc_track.h"
+#include "probes.h"
+
+//Frame ------------------------------------------------------------------
+
+Frame::Frame()
+{
+	frame_buffer_init(&buf);
+}
+
+Frame::~Frame()
+{
+	frame_buffer_free(&buf);
+}
+
+Frame::Frame(Frame &&other)
+{
+	buf=other.buf;
+	frame_buffer_init(&other.buf);
+}
+
+Frame &Frame::operator=(Frame &&other)
+{
+	if(this!=&other){
+		frame_buffer_free(&buf);
+		buf=other.buf;
+		frame_buffer_init(&other.buf);
+	}
+	return *this;
+}
+
+int Frame::alloc(int w,int h,AVPixelFormat pixfmt)
+{
+	return frame_buffer_ensure(&buf,w,h,pixfmt);
+}
+
+void Frame::reset()
+{
+	frame_buffer_free(&buf);
+}
+
+//Scaler -----------------------------------------------------------------
+
+int init_sws_context(struct SwsContext *ctx,int src_w,int src_h,AVPixelFormat src_pixfmt,
+					 int dst_w,int dst_h,AVPixelFormat dst_pixfmt,int flags)
+{
+	av_opt_set_int(ctx,"sws_flags",flags,0);
+	av_opt_set_int(ctx,"srcw",src_w,0);
+	av_opt_set_int(ctx,"srch",src_h,0);
+	av_opt_set_int(ctx,"src_format",src_pixfmt,0);
+	//'0' for MPEG (Y:0-235);'1' for JPEG (Y:0-255)
+	av_opt_set_int(ctx,"src_range",1,0);
+	av_opt_set_int(ctx,"dstw",dst_w,0);
+	av_opt_set_int(ctx,"dsth",dst_h,0);
+	av_opt_set_int(ctx,"dst_format",dst_pixfmt,0);
+	av_opt_set_int(ctx,"dst_range",1,0);
+	return sws_init_context(ctx,NULL,NULL);
+}
+
+Scaler::Scaler()
+	:ctx(NULL),src_w(0),src_h(0),dst_w(0),dst_h(0),
+	src_pixfmt(AV_PIX_FMT_NONE),dst_pixfmt(AV_PIX_FMT_NONE)
+{
+}
+
+Scaler::~Scaler()
+{
+	AllocScope scope(ALLOC_TAG_SWSCALE);
+	sws_freeContext(ctx);
+}
+
+Scaler::Scaler(Scaler &&other)
+	:ctx(other.ctx),src_w(other.src_w),src_h(other.src_h),dst_w(other.dst_w),dst_h(other.dst_h),
+	src_pixfmt(other.src_pixfmt),dst_pixfmt(other.dst_pixfmt)
+{
+	other.ctx=NULL;
+}
+
+Scaler &Scaler::operator=(Scaler &&other)
+{
+	if(this!=&other){
+		AllocScope scope(ALLOC_TAG_SWSCALE);
+		sws_freeContext(ctx);
+		ctx=other.ctx;
+		src_w=other.src_w;
+		src_h=other.src_h;
+		src_pixfmt=other.src_pixfmt;
+		dst_w=other.dst_w;
+		dst_h=other.dst_h;
+		dst_pixfmt=other.dst_pixfmt;
+		other.ctx=NULL;
+	}
+	return *this;
+}
+
+int Scaler::init(int src_w,int src_h,AVPixelFormat src_pixfmt,
+				 int dst_w,int dst_h,AVPixelFormat dst_pixfmt,int flags)
+{
+	AllocScope scope(ALLOC_TAG_SWSCALE);
+	reset();
+	ctx=sws_alloc_context();
+	if(!ctx)
+		return -1;
+	if(init_sws_context(ctx,src_w,src_h,src_pixfmt,dst_w,dst_h,dst_pixfmt,flags)<0){
+		reset();
+		return -1;
+	}
+	this->src_w=src_w;
+	this->src_h=src_h;
+	this->src_pixfmt=src_pixfmt;
+	this->dst_w=dst_w;
+	this->dst_h=dst_h;
+	this->dst_pixfmt=dst_pixfmt;
+	PROBE_CONTEXT_CREATE(ctx,src_w,src_h,src_pixfmt,dst_w,dst_h,dst_pixfmt,flags);
+	return 0;
+}
+
+void Scaler::reset()
+{
+	AllocScope scope(ALLOC_TAG_SWSCALE);
+	sws_freeContext(ctx);
+	ctx=NULL;
+}
+
+int Scaler::scale(const Frame &src,Frame &dst)
+{
+	if(!ctx||src.width()!=src_w||src.height()!=src_h||src.pixfmt()!=src_pixfmt||
+		dst.width()!=dst_w||dst.height()!=dst_h||dst.pixfmt()!=dst_pixfmt)
+		return -1;
+	PROBE_SCALE_START(ctx,src_h);
+	sws_scale(ctx,src.data(),src.linesize(),0,src_h,dst.data(),dst.linesize());
+	PROBE_SCALE_END(ctx,src_h);
+	return 0;
+}
+
+//Raw files --------------------------------------------------------------
+
+RawFileSource::RawFileSource()
+	:file(NULL),fill(NULL),temp_buffer(NULL),w(0),h(0),pixfmt(AV_PIX_FMT_NONE)
+{
+}
+
+RawFileSource::~RawFileSource()
+{
+	close();
+}
+
+int RawFileSource::open(const char *path,int w,int h,AVPixelFormat pixfmt)
+{
+	FILE *f=fopen(path,"rb");
+	if(!f){
+		printf("Could not open %s\n",path);
+		return -1;
+	}
+	return open(f,w,h,pixfmt);
+}
+
+int RawFileSource::open(FILE *file,int w,int h,AVPixelFormat pixfmt)
+{
+	close();
+	this->file=file;
+	fill=get_fill_planes(pixfmt);
+	if(!fill||check_frame_size(pixfmt,w,h)<0)
+		return -1;
+	temp_buffer=(uint8_t *)malloc(raw_frame_size(pixfmt,w,h));
+	if(!temp_buffer)
+		return -1;
+	this->w=w;
+	this->h=h;
+	this->pixfmt=pixfmt;
+	return 0;
+}
+
+void RawFileSource::close()
+{
+	if(file)
+		fclose(file);
+	free(temp_buffer);
+	file=NULL;
+	temp_buffer=NULL;
+}
+
+int RawFileSource::read(Frame &frame)
+{
+	int size=raw_frame_size(pixfmt,w,h);
+	size_t n;
+	if(!temp_buffer||frame.width()!=w||frame.height()!=h||frame.pixfmt()!=pixfmt)
+		return -1;
+	PROBE_IO_SUBMIT(PROBE_IO_READ);
+	n=fread(temp_buffer,1,size,file);
+	PROBE_IO_COMPLETE(PROBE_IO_READ,(int64_t)n);
+	if(n!=(size_t)size)
+		return n>0||ferror(file)?-1:0;
+	fill(frame.data(),temp_buffer,w,h);
+	return 1;
+}
+
+RawFileSink::RawFileSink()
+	:file(NULL),pixfmt(AV_PIX_FMT_NONE),write_func(NULL)
+{
+}
+
+RawFileSink::~RawFileSink()
+{
+	close();
+}
+
+int RawFileSink::open(const char *path)
+{
+	close();
+	file=fopen(path,"wb");
+	if(!file){
+		printf("Could not open %s\n",path);
+		return -1;
+	}
+	return 0;
+}
+
+int RawFileSink::close()
+{
+	int ret=0;
+	if(file&&fclose(file)!=0)
+		ret=-1;
+	file=NULL;
+	return ret;
+}
+
+int RawFileSink::write(const Frame &frame)
+{
+	if(!file)
+		return -1;
+	if(frame.pixfmt()!=pixfmt){
+		write_func=get_write_planes(frame.pixfmt());
+		pixfmt=frame.pixfmt();
+	}
+	if(!write_func)
+		return -1;
+	PROBE_IO_SUBMIT(PROBE_IO_WRITE);
+	int ret=write_func(file,frame.data(),frame.width(),frame.height());
+	PROBE_IO_COMPLETE(PROBE_IO_WRITE,ret);
+	return ret;
+}
+
+int64_t scale_frames(FrameSource &source,Scaler &scaler,FrameSink &sink,Frame &src,Frame &dst)
+{
+	int64_t frames=0;
+	while(1){
+		PROBE_FRAME_START(-1,frames);
+		int ret=source.read(src);
+		if(ret<=0){
+			PROBE_FRAME_END(-1,frames,ret<0?-1:1);
+			if(ret<0)
+				return -1;
+			break;
+		}
+		if(scaler.scale(src,dst)<0||sink.write(dst)<0){
+			PROBE_FRAME_END(-1,frames,-1);
+			return -1;
+		}
+		PROBE_FRAME_END(-1,frames,0);
+		frames++;
+	}
+	return frames;
+}
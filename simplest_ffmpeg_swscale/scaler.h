@@ -0,0 +1,170 @@
+/**
+ * Scaling library
+ *
+ * The conversion steps of main() as types that can be embedded in another
+ * program: a Frame owns its planes, a Scaler owns an initialized
+ * SwsContext, and a FrameSource / FrameSink moves frames in and out.
+ * Frame and Scaler are move-only.
+ *
+ * Setup (Frame::alloc(), Scaler::init(), the open() methods) may allocate.
+ * The per-frame methods (FrameSource::read(), Scaler::scale(),
+ * FrameSink::write()) never do, so a conversion loop does not touch the
+ * heap after the first frame. Errors are returned as <0, nothing throws.
+ *
+ *   Frame src,dst;
+ *   Scaler scaler;
+ *   RawFileSource source;
+ *   RawFileSink sink;
+ *   if(source.open("in.yuv",480,272,AV_PIX_FMT_YUV420P)<0||sink.open("out.rgb")<0||
+ *       src.alloc(480,272,AV_PIX_FMT_YUV420P)<0||dst.alloc(1280,720,AV_PIX_FMT_RGB24)<0||
+ *       scaler.init(480,272,AV_PIX_FMT_YUV420P,1280,720,AV_PIX_FMT_RGB24,SWS_BICUBIC)<0)
+ *       return -1;
+ *   int64_t frames=scale_frames(source,scaler,sink,src,dst);
+ */
+
+#ifndef SCALER_H
+#define SCALER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+extern "C"
+{
+#include "libswscale/swscale.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libswscale/swscale.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+#include "frame_io.h"
+
+class Frame{
+public:
+	Frame();
+	~Frame();
+	Frame(Frame &&other);
+	Frame &operator=(Frame &&other);
+	Frame(const Frame &)=delete;
+	Frame &operator=(const Frame &)=delete;
+
+	//Keeps the planes if size and format are unchanged
+	int alloc(int w,int h,AVPixelFormat pixfmt);
+	void reset();
+
+	bool empty() const { return !buf.data[0]; }
+	int width() const { return buf.w; }
+	int height() const { return buf.h; }
+	AVPixelFormat pixfmt() const { return buf.pixfmt; }
+	uint8_t *const *data() const { return buf.data; }
+	const int *linesize() const { return buf.linesize; }
+
+private:
+	FrameBuffer buf;
+};
+
+class Scaler{
+public:
+	Scaler();
+	~Scaler();
+	Scaler(Scaler &&other);
+	Scaler &operator=(Scaler &&other);
+	Scaler(const Scaler &)=delete;
+	Scaler &operator=(const Scaler &)=delete;
+
+	//Full range in and out, as in main(). Replaces the current context.
+	int init(int src_w,int src_h,AVPixelFormat src_pixfmt,
+		int dst_w,int dst_h,AVPixelFormat dst_pixfmt,int flags);
+	void reset();
+
+	//Frames must match the size and format given to init()
+	int scale(const Frame &src,Frame &dst);
+
+	struct SwsContext *context() const { return ctx; }
+
+private:
+	struct SwsContext *ctx;
+	int src_w,src_h,dst_w,dst_h;
+	AVPixelFormat src_pixfmt,dst_pixfmt;
+};
+
+//Init Method 1 of main(): set the parameters as AVOptions (full range),
+//then initialize. For callers that manage the context themselves.
+int init_sws_context(struct SwsContext *ctx,int src_w,int src_h,AVPixelFormat src_pixfmt,
+					 int dst_w,int dst_h,AVPixelFormat dst_pixfmt,int flags);
+
+class FrameSource{
+public:
+	virtual ~FrameSource() {}
+	//1 if a frame was read into frame, 0 at the end, <0 on error
+	virtual int read(Frame &frame)=0;
+};
+
+class FrameSink{
+public:
+	virtual ~FrameSink() {}
+	virtual int write(const Frame &frame)=0;
+};
+
+//Frames from a raw file (see frame_io.h)
+class RawFileSource:public FrameSource{
+public:
+	RawFileSource();
+	~RawFileSource();
+	RawFileSource(const RawFileSource &)=delete;
+	RawFileSource &operator=(const RawFileSource &)=delete;
+
+	int open(const char *path,int w,int h,AVPixelFormat pixfmt);
+	//Takes ownership of file
+	int open(FILE *file,int w,int h,AVPixelFormat pixfmt);
+	void close();
+
+	//frame must be allocated with the size and format given to open().
+	//A partial frame at the end is an error.
+	int read(Frame &frame);
+
+private:
+	FILE *file;
+	FillPlanesFunc fill;
+	uint8_t *temp_buffer;
+	int w,h;
+	AVPixelFormat pixfmt;
+};
+
+//Frames to a raw file
+class RawFileSink:public FrameSink{
+public:
+	RawFileSink();
+	~RawFileSink();
+	RawFileSink(const RawFileSink &)=delete;
+	RawFileSink &operator=(const RawFileSink &)=delete;
+
+	int open(const char *path);
+	//Flushes the file, <0 if data could not be written
+	int close();
+
+	int write(const Frame &frame);
+
+private:
+	FILE *file;
+	//Looked up again only when the frame format changes
+	AVPixelFormat pixfmt;
+	WritePlanesFunc write_func;
+};
+
+//Read, scale and write until the source ends. src and dst must be
+//allocated to match scaler. Returns the number of frames, <0 on error.
+int64_t scale_frames(FrameSource &source,Scaler &scaler,FrameSink &sink,Frame &src,Frame &dst);
+
+#endif
@@ -20,6 +20,8 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define __STDC_CONSTANT_MACROS
 
@@ -45,61 +47,257 @@ extern "C"
 #endif
 #endif
 
+#include "alloc_track.h"
+#include "batch.h"
+#include "frame_io.h"
+#include "stream_sched.h"
+#include "realtime.h"
+#include "scale_daemon.h"
+#include "scaler.h"
+#include "pal8_expand.h"
+#include "verify.h"
+#include "pattern_source.h"
+#include "thread_bench.h"
+#include "cache_sweep.h"
+#include "perf_counters.h"
+#include "trace.h"
+#include "mem_report.h"
+#include "regress.h"
+#include "probes.h"
+
+//Run a few frames of one format pair through the same setup and
+//read/convert/write path as main(). Returns allocations after frame 1,
+//or <0 if the check could not be set up.
+static int64_t alloc_check_pair(AVPixelFormat src_pixfmt,AVPixelFormat dst_pixfmt)
+{
+	const int src_w=320,src_h=240;
+	const int dst_w=480,dst_h=272;
+	const int frame_num=3;
+	int src_size=raw_frame_size(src_pixfmt,src_w,src_h);
+	int64_t steady_allocs=0;
+	Frame src,dst;
+	Scaler scaler;
+	RawFileSource source;
+	RawFileSink sink;
+	FILE *src_file;
+	uint8_t *pattern;
+
+	//Setup: everything here may allocate
+	src_file=tmpfile();
+	pattern=(uint8_t *)malloc(src_size);
+	if(!src_file||!pattern){
+		printf("Could not set up allocation check\n");
+		if(src_file)
+			fclose(src_file);
+		free(pattern);
+		return -1;
+	}
+	for(int k=0;k<src_size;k++)
+		pattern[k]=k*7;
+	for(int k=0;k<frame_num;k++)
+		fwrite(pattern,1,src_size,src_file);
+	free(pattern);
+	rewind(src_file);
+	if(source.open(src_file,src_w,src_h,src_pixfmt)<0||
+#ifdef _WIN32
+		sink.open("NUL")<0){
+#else
+		sink.open("/dev/null")<0){
+#endif
+		printf("Could not set up allocation check\n");
+		return -1;
+	}
+	if(src.alloc(src_w,src_h,src_pixfmt)<0||dst.alloc(dst_w,dst_h,dst_pixfmt)<0){
+		printf("Could not allocate image\n");
+		return -1;
+	}
+	if(scaler.init(src_w,src_h,src_pixfmt,dst_w,dst_h,dst_pixfmt,SWS_BICUBIC)<0){
+		printf("Could not create context for %s -> %s\n",
+			av_get_pix_fmt_name(src_pixfmt),av_get_pix_fmt_name(dst_pixfmt));
+		return -1;
+	}
+
+	for(int frame_idx=0;frame_idx<frame_num;frame_idx++){
+		AllocStats before;
+		alloc_track_get(&before);
+		if(source.read(src)<=0)
+			break;
+		scaler.scale(src,dst);
+		sink.write(dst);
+		//The first frame may allocate (stdio buffers, lazily built tables)
+		if(frame_idx>0)
+			steady_allocs+=alloc_track_allocs_since(&before);
+	}
+	return steady_allocs;
+}
+
+//Check every supported format pair and fail if anything is allocated
+//after the first frame. Needs a build with -DALLOC_TRACK.
+static int alloc_check()
+{
+	int n_fmts=nb_supported_pixfmts;
+	int failed=0;
+
+	if(!alloc_track_enabled()){
+		printf("Allocation tracking is not compiled in (build with -DALLOC_TRACK).\n");
+		return -1;
+	}
+	//Same limit as the av_malloc() default
+	alloc_track_max_alloc(INT_MAX);
+
+	for(int i=0;i<n_fmts;i++){
+		for(int j=0;j<n_fmts;j++){
+			AVPixelFormat src_pixfmt=supported_pixfmts[i];
+			AVPixelFormat dst_pixfmt=supported_pixfmts[j];
+			int64_t steady_allocs=alloc_check_pair(src_pixfmt,dst_pixfmt);
+			if(steady_allocs<0)
+				return -1;
+			printf("%-8s -> %-8s : %s (%lld allocations after frame 1)\n",
+				av_get_pix_fmt_name(src_pixfmt),av_get_pix_fmt_name(dst_pixfmt),
+				steady_allocs?"FAIL":"OK",(long long)steady_allocs);
+			if(steady_allocs)
+				failed++;
+		}
+	}
+	printf("Allocation check: %d of %d format pairs allocate in steady state.\n",failed,n_fmts*n_fmts);
+	return failed?1:0;
+}
 
 int main(int argc, char* argv[])
 {
+	//In front of any of the modes below:
+	//Trace it (see trace.h): simplest_ffmpeg_swscale -trace out.json [mode...]
+	//Report its memory at exit and on SIGUSR1 (see mem_report.h): simplest_ffmpeg_swscale -memreport [mode...]
+	while(argc>1){
+		if(argc>2&&strcmp(argv[1],"-trace")==0){
+			if(trace_open(argv[2])<0)
+				return -1;
+			atexit(trace_close);
+			argc-=2;
+			argv+=2;
+		}else if(strcmp(argv[1],"-memreport")==0){
+			if(mem_report_install()<0)
+				return -1;
+			argc--;
+			argv++;
+		}else{
+			break;
+		}
+	}
+	if(argc>1&&strcmp(argv[1],"-alloccheck")==0)
+		return alloc_check();
+	//Batch: simplest_ffmpeg_swscale -batch manifest.txt [threads]
+	if(argc>2&&strcmp(argv[1],"-batch")==0)
+		return batch_main(argv[2],argc>3?atoi(argv[3]):0);
+	//Many concurrent streams: simplest_ffmpeg_swscale -streams manifest.txt [threads]
+	if(argc>2&&strcmp(argv[1],"-streams")==0)
+		return streams_main(argv[2],argc>3?atoi(argv[3]):0);
+	//Live output: simplest_ffmpeg_swscale -realtime manifest.txt fps
+	if(argc>3&&strcmp(argv[1],"-realtime")==0)
+		return realtime_main(argv[2],atof(argv[3]));
+	//Serve local clients: simplest_ffmpeg_swscale -daemon socket [threads]
+	if(argc>2&&strcmp(argv[1],"-daemon")==0)
+		return scale_daemon_main(argv[2],argc>3?atoi(argv[3]):0);
+	//Convert through a daemon: simplest_ffmpeg_swscale -client socket manifest.txt
+	if(argc>3&&strcmp(argv[1],"-client")==0)
+		return scale_client_main(argv[2],argv[3]);
+	//PAL8 expansion benchmark: simplest_ffmpeg_swscale -pal8bench [w h]
+	if(argc>1&&strcmp(argv[1],"-pal8bench")==0)
+		return pal8_bench(argc>3?atoi(argv[2]):1920,argc>3?atoi(argv[3]):1080);
+	//sws_scale() throughput on generated frames, no file I/O (see pattern_source.h):
+	//simplest_ffmpeg_swscale -bench src_pixfmt src_w src_h dst_pixfmt dst_w dst_h [flags [frames [pattern]]]
+	if(argc>7&&strcmp(argv[1],"-bench")==0){
+		AVPixelFormat bench_src=av_get_pix_fmt(argv[2]),bench_dst=av_get_pix_fmt(argv[5]);
+		int bench_flags=parse_sws_flags(argc>8?argv[8]:"bicubic");
+		if(bench_src==AV_PIX_FMT_NONE||bench_dst==AV_PIX_FMT_NONE||bench_flags<0){
+			printf("Unknown pixel format or scaler\n");
+			return -1;
+		}
+		return scale_bench(bench_src,atoi(argv[3]),atoi(argv[4]),bench_dst,atoi(argv[6]),atoi(argv[7]),
+			bench_flags,argc>9?atoi(argv[9]):100,argc>10?argv[10]:"movingbars");
+	}
+	//Thread scaling of the same conversion (see thread_bench.h):
+	//simplest_ffmpeg_swscale -threadbench src_pixfmt dst_pixfmt [flags [max_threads]]
+	if(argc>3&&strcmp(argv[1],"-threadbench")==0){
+		AVPixelFormat bench_src=av_get_pix_fmt(argv[2]),bench_dst=av_get_pix_fmt(argv[3]);
+		int bench_flags=parse_sws_flags(argc>4?argv[4]:"bicubic");
+		if(bench_src==AV_PIX_FMT_NONE||bench_dst==AV_PIX_FMT_NONE||bench_flags<0){
+			printf("Unknown pixel format or scaler\n");
+			return -1;
+		}
+		return thread_bench(bench_src,bench_dst,bench_flags,argc>5?atoi(argv[5]):0);
+	}
+	//ns/pixel over a range of widths against the cache sizes (see cache_sweep.h):
+	//simplest_ffmpeg_swscale -cachesweep src_pixfmt dst_pixfmt [flags [dst_ratio [min_w max_w step [out.csv]]]]
+	if(argc>3&&strcmp(argv[1],"-cachesweep")==0){
+		AVPixelFormat bench_src=av_get_pix_fmt(argv[2]),bench_dst=av_get_pix_fmt(argv[3]);
+		int bench_flags=parse_sws_flags(argc>4?argv[4]:"bicubic");
+		if(bench_src==AV_PIX_FMT_NONE||bench_dst==AV_PIX_FMT_NONE||bench_flags<0){
+			printf("Unknown pixel format or scaler\n");
+			return -1;
+		}
+		return cache_sweep(bench_src,bench_dst,bench_flags,argc>5?atof(argv[5]):1.0,
+			argc>8?atoi(argv[6]):256,argc>8?atoi(argv[7]):8192,argc>8?atoi(argv[8]):128,argc>9?argv[9]:NULL);
+	}
+	//Record conversions of a generated pattern (see verify.h):
+	//simplest_ffmpeg_swscale -golden pattern.manifest golden.manifest dst_w dst_h dst_pixfmt [flags]
+	if(argc>6&&strcmp(argv[1],"-golden")==0)
+		return golden_main(argv[2],argv[3],atoi(argv[4]),atoi(argv[5]),argv[6],argc>7?argv[7]:"bicubic");
+	//Check them again: simplest_ffmpeg_swscale -verify golden.manifest
+	if(argc>2&&strcmp(argv[1],"-verify")==0)
+		return verify_main(argv[2]);
+	//Speed and memory against a stored baseline (see regress.h):
+	//simplest_ffmpeg_swscale -regress record|check baseline.json [trials [tolerance% [mem_tolerance%]]]
+	if(argc>3&&strcmp(argv[1],"-regress")==0)
+		return regress_main(argv[2],argv[3],argc>4?atoi(argv[4]):5,
+			argc>5?atof(argv[5]):10,argc>6?atof(argv[6]):5);
+
+	//Hardware counters per stage of the conversion below (see perf_counters.h):
+	//simplest_ffmpeg_swscale -perf
+	bool perf=argc>1&&strcmp(argv[1],"-perf")==0;
+
 	//Parameters	
-	FILE *src_file =fopen("sintel_480x272_yuv420p.yuv", "rb");
+	const char *src_path="sintel_480x272_yuv420p.yuv";
 	const int src_w=480,src_h=272;
 	AVPixelFormat src_pixfmt=AV_PIX_FMT_YUV420P;
 
-	int src_bpp=av_get_bits_per_pixel(av_pix_fmt_desc_get(src_pixfmt));
-
-	FILE *dst_file = fopen("sintel_1280x720_rgb24.rgb", "wb");
+	const char *dst_path="sintel_1280x720_rgb24.rgb";
 	const int dst_w=1280,dst_h=720;
 	AVPixelFormat dst_pixfmt=AV_PIX_FMT_RGB24;
-	int dst_bpp=av_get_bits_per_pixel(av_pix_fmt_desc_get(dst_pixfmt));
 
 	//Structures
-	uint8_t *src_data[4];
-	int src_linesize[4];
-
-	uint8_t *dst_data[4];
-	int dst_linesize[4];
+	Frame src,dst;
+	Scaler scaler;
+	RawFileSource source;
+	RawFileSink sink;
+	PerfCounters *perf_counters=NULL;
+	PerfStage stages[3];
 
 	int rescale_method=SWS_BICUBIC;
-	struct SwsContext *img_convert_ctx;
-	uint8_t *temp_buffer=(uint8_t *)malloc(src_w*src_h*src_bpp/8);
-	
 	int frame_idx=0;
 	int ret=0;
-	ret= av_image_alloc(src_data, src_linesize,src_w, src_h, src_pixfmt, 1);
+	if(source.open(src_path,src_w,src_h,src_pixfmt)<0||sink.open(dst_path)<0)
+		return -1;
+	ret=src.alloc(src_w,src_h,src_pixfmt);
 	if (ret< 0) {
 		printf( "Could not allocate source image\n");
 		return -1;
 	}
-	ret = av_image_alloc(dst_data, dst_linesize,dst_w, dst_h, dst_pixfmt, 1);
+	ret=dst.alloc(dst_w,dst_h,dst_pixfmt);
 	if (ret< 0) {
 		printf( "Could not allocate destination image\n");
 		return -1;
 	}
 	//-----------------------------	
-	//Init Method 1
-	img_convert_ctx =sws_alloc_context();
-	//Show AVOption
-	av_opt_show2(img_convert_ctx,stdout,AV_OPT_FLAG_VIDEO_PARAM,0);
-	//Set Value
-	av_opt_set_int(img_convert_ctx,"sws_flags",SWS_BICUBIC|SWS_PRINT_INFO,0);
-	av_opt_set_int(img_convert_ctx,"srcw",src_w,0);
-	av_opt_set_int(img_convert_ctx,"srch",src_h,0);
-	av_opt_set_int(img_convert_ctx,"src_format",src_pixfmt,0);
-	//'0' for MPEG (Y:0-235);'1' for JPEG (Y:0-255)
-	av_opt_set_int(img_convert_ctx,"src_range",1,0);
-	av_opt_set_int(img_convert_ctx,"dstw",dst_w,0);
-	av_opt_set_int(img_convert_ctx,"dsth",dst_h,0);
-	av_opt_set_int(img_convert_ctx,"dst_format",dst_pixfmt,0);
-	av_opt_set_int(img_convert_ctx,"dst_range",1,0);
-	sws_init_context(img_convert_ctx,NULL,NULL);
+	//Show AVOption (on a context that is not initialized yet)
+	struct SwsContext *opt_ctx=sws_alloc_context();
+	av_opt_show2(opt_ctx,stdout,AV_OPT_FLAG_VIDEO_PARAM,0);
+	sws_freeContext(opt_ctx);
+	//Init Method 1 (see init_sws_context())
+	if(scaler.init(src_w,src_h,src_pixfmt,dst_w,dst_h,dst_pixfmt,rescale_method|SWS_PRINT_INFO)<0){
+		printf( "Could not initialize context\n");
+		return -1;
+	}
 
 	//Init Method 2
 	//img_convert_ctx = sws_getContext(src_w, src_h,src_pixfmt, dst_w, dst_h, dst_pixfmt, 
@@ -107,7 +305,7 @@ int main(int argc, char* argv[])
 	//-----------------------------
 	/*
 	//Colorspace
-	ret=sws_setColorspaceDetails(img_convert_ctx,sws_getCoefficients(SWS_CS_ITU601),0,
+	ret=sws_setColorspaceDetails(scaler.context(),sws_getCoefficients(SWS_CS_ITU601),0,
 		sws_getCoefficients(SWS_CS_ITU709),0,
 		 0, 1 << 16, 1 << 16);
 	if (ret==-1) {
@@ -115,98 +313,70 @@ int main(int argc, char* argv[])
 		return -1;
 	}
 	*/
+	if(perf&&!(perf_counters=perf_counters_alloc()))
+		return -1;
+	perf_stage_init(&stages[0],"read");
+	perf_stage_init(&stages[1],"scale");
+	perf_stage_init(&stages[2],"write");
 	while(1)
 	{
-		if (fread(temp_buffer, 1, src_w*src_h*src_bpp/8, src_file) != src_w*src_h*src_bpp/8){
-			break;
+		AllocStats alloc_before;
+		alloc_track_get(&alloc_before);
+		if(perf)
+			perf_stage_begin(perf_counters,&stages[0]);
+		PROBE_FRAME_START(-1,frame_idx);
+		int64_t stage_start=trace_now();
+		ret=source.read(src);
+		if(ret<0){
+			printf("%s: truncated frame %d\n",src_path,frame_idx);
+			return -1;
 		}
-		
-		switch(src_pixfmt){
-		case AV_PIX_FMT_GRAY8:{
-			memcpy(src_data[0],temp_buffer,src_w*src_h);
+		if(ret==0){
+			PROBE_FRAME_END(-1,frame_idx,1);
 			break;
-							  }
-		case AV_PIX_FMT_YUV420P:{
-			memcpy(src_data[0],temp_buffer,src_w*src_h);                    //Y
-			memcpy(src_data[1],temp_buffer+src_w*src_h,src_w*src_h/4);      //U
-			memcpy(src_data[2],temp_buffer+src_w*src_h*5/4,src_w*src_h/4);  //V
-			break;
-								}
-		case AV_PIX_FMT_YUV422P:{
-			memcpy(src_data[0],temp_buffer,src_w*src_h);                    //Y
-			memcpy(src_data[1],temp_buffer+src_w*src_h,src_w*src_h/2);      //U
-			memcpy(src_data[2],temp_buffer+src_w*src_h*3/2,src_w*src_h/2);  //V
-			break;
-								}
-		case AV_PIX_FMT_YUV444P:{
-			memcpy(src_data[0],temp_buffer,src_w*src_h);                    //Y
-			memcpy(src_data[1],temp_buffer+src_w*src_h,src_w*src_h);        //U
-			memcpy(src_data[2],temp_buffer+src_w*src_h*2,src_w*src_h);      //V
-			break;
-								}
-		case AV_PIX_FMT_YUYV422:{
-			memcpy(src_data[0],temp_buffer,src_w*src_h*2);                  //Packed
-			break;
-								}
-		case AV_PIX_FMT_RGB24:{
-			memcpy(src_data[0],temp_buffer,src_w*src_h*3);                  //Packed
-			break;
-								}
-		default:{
-			printf("Not Support Input Pixel Format.\n");
-			break;
-							  }
 		}
-		
-		sws_scale(img_convert_ctx, src_data, src_linesize, 0, src_h, dst_data, dst_linesize);
-		printf("Finish process frame %5d\n",frame_idx);
-		frame_idx++;
+		if(perf){
+			perf_stage_end(perf_counters,&stages[0],dst_w*dst_h);
+			perf_stage_begin(perf_counters,&stages[1]);
+		}
+		trace_span("read",stage_start,-1,frame_idx);
 
-		switch(dst_pixfmt){
-		case AV_PIX_FMT_GRAY8:{
-			fwrite(dst_data[0],1,dst_w*dst_h,dst_file);	
-			break;
-							  }
-		case AV_PIX_FMT_YUV420P:{
-			fwrite(dst_data[0],1,dst_w*dst_h,dst_file);                 //Y
-			fwrite(dst_data[1],1,dst_w*dst_h/4,dst_file);               //U
-			fwrite(dst_data[2],1,dst_w*dst_h/4,dst_file);               //V
-			break;
-								}
-		case AV_PIX_FMT_YUV422P:{
-			fwrite(dst_data[0],1,dst_w*dst_h,dst_file);					//Y
-			fwrite(dst_data[1],1,dst_w*dst_h/2,dst_file);				//U
-			fwrite(dst_data[2],1,dst_w*dst_h/2,dst_file);				//V
-			break;
-								}
-		case AV_PIX_FMT_YUV444P:{
-			fwrite(dst_data[0],1,dst_w*dst_h,dst_file);                 //Y
-			fwrite(dst_data[1],1,dst_w*dst_h,dst_file);                 //U
-			fwrite(dst_data[2],1,dst_w*dst_h,dst_file);                 //V
-			break;
-								}
-		case AV_PIX_FMT_YUYV422:{
-			fwrite(dst_data[0],1,dst_w*dst_h*2,dst_file);               //Packed
-			break;
-								}
-		case AV_PIX_FMT_RGB24:{
-			fwrite(dst_data[0],1,dst_w*dst_h*3,dst_file);               //Packed
-			break;
-							  }
-		default:{
-			printf("Not Support Output Pixel Format.\n");
-			break;
-							}
+		stage_start=trace_now();
+		scaler.scale(src,dst);
+		trace_span("scale",stage_start,-1,frame_idx);
+		if(perf){
+			perf_stage_end(perf_counters,&stages[1],dst_w*dst_h);
+			perf_stage_begin(perf_counters,&stages[2]);
 		}
-	}
 
-	sws_freeContext(img_convert_ctx);
+		stage_start=trace_now();
+		if(sink.write(dst)<0){
+			printf("%s: write error\n",dst_path);
+			return -1;
+		}
+		trace_span("write",stage_start,-1,frame_idx);
+		PROBE_FRAME_END(-1,frame_idx,0);
+		if(perf)
+			perf_stage_end(perf_counters,&stages[2],dst_w*dst_h);
+		//Console output after the measured stages
+		printf("Finish process frame %5d\n",frame_idx);
+		if(perf){
+			for(int i=0;i<3;i++)
+				perf_stage_print_frame(&stages[i],frame_idx);
+		}
+		frame_idx++;
 
-	free(temp_buffer);
-	fclose(dst_file);
-	av_freep(&src_data[0]);
-	av_freep(&dst_data[0]);
+		if(alloc_track_enabled())
+			printf("Frame %5d allocations: %lld\n",frame_idx-1,(long long)alloc_track_allocs_since(&alloc_before));
+	}
 
+	if(sink.close()<0){
+		printf("%s: write error\n",dst_path);
+		return -1;
+	}
+	if(perf){
+		perf_stage_print_summary(stages,3);
+		perf_counters_free(&perf_counters);
+	}
 	return 0;
 }
-
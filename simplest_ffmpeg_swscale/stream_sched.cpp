@@ -0,0 +1,550 @@
+/**
+ * Multi-stream scheduler
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+extern "C"
+{
+#include "libswscale/swscale.h"
+#include "libavutil/time.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libswscale/swscale.h>
+#include <libavutil/time.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+#include "stream_sched.h"
+#include "batch.h"
+#include "frame_io.h"
+#include "trace.h"
+#include "probes.h"
+
+typedef struct StreamFrame{
+	uint8_t *src_data[4];
+	int src_linesize[4];
+	uint8_t *dst_data[4];
+	int dst_linesize[4];
+	void *opaque;
+	int64_t submit_time;
+}StreamFrame;
+
+typedef struct Stream{
+	int idx;
+	struct SwsContext *ctx;
+	int src_h;
+	StreamFrameDone done;
+	void *opaque;
+	std::mutex lock;
+	std::deque<StreamFrame> frames;
+	int scheduled;            //In a run queue or being run
+	StreamStats stats;
+}Stream;
+
+typedef struct Worker{
+	std::mutex lock;
+	std::deque<Stream *> queue;
+}Worker;
+
+struct StreamScheduler{
+	SwsCache *cache;
+	int quantum;
+	int nb_threads;
+	Worker *workers;
+	std::thread *threads;
+
+	std::mutex streams_lock;
+	std::vector<Stream *> streams;
+	std::atomic<unsigned> next_worker;
+
+	//Sleeping workers wait here; 'queued' is the number of queued streams
+	std::mutex idle_lock;
+	std::condition_variable idle_cond;
+	std::atomic<int> queued;
+	int exit;
+
+	//Frames submitted but not done
+	std::mutex pending_lock;
+	std::condition_variable pending_cond;
+	int64_t pending;
+};
+
+static void push_stream(StreamScheduler *sched,int worker_idx,Stream *st)
+{
+	{
+		std::lock_guard<std::mutex> guard(sched->workers[worker_idx].lock);
+		sched->workers[worker_idx].queue.push_back(st);
+	}
+	trace_counter("queued streams",++sched->queued);
+	std::lock_guard<std::mutex> guard(sched->idle_lock);
+	sched->idle_cond.notify_one();
+}
+
+//Own queue from the front, other queues from the back
+static Stream *pop_stream(StreamScheduler *sched,int worker_idx)
+{
+	for(int i=0;i<sched->nb_threads;i++){
+		int victim=(worker_idx+i)%sched->nb_threads;
+		Worker *w=&sched->workers[victim];
+		std::lock_guard<std::mutex> guard(w->lock);
+		if(w->queue.empty())
+			continue;
+		Stream *st;
+		if(i==0){
+			st=w->queue.front();
+			w->queue.pop_front();
+		}else{
+			st=w->queue.back();
+			w->queue.pop_back();
+		}
+		trace_counter("queued streams",--sched->queued);
+		return st;
+	}
+	return NULL;
+}
+
+static void run_stream(StreamScheduler *sched,int worker_idx,Stream *st)
+{
+	for(int n=0;n<sched->quantum;n++){
+		StreamFrame frame;
+		{
+			std::lock_guard<std::mutex> guard(st->lock);
+			if(st->frames.empty())
+				break;
+			frame=st->frames.front();
+			st->frames.pop_front();
+		}
+		int64_t scale_start=trace_now();
+		PROBE_SCALE_START(st->ctx,st->src_h);
+		sws_scale(st->ctx,frame.src_data,frame.src_linesize,0,st->src_h,frame.dst_data,frame.dst_linesize);
+		PROBE_SCALE_END(st->ctx,st->src_h);
+		int64_t now=av_gettime();
+		int64_t latency=now-frame.submit_time;
+		int64_t frame_idx;
+		{
+			//stream_sched_get_stats() may read them meanwhile
+			std::lock_guard<std::mutex> guard(st->lock);
+			frame_idx=st->stats.frames++;
+			st->stats.latency_sum_us+=latency;
+			if(latency>st->stats.latency_max_us)
+				st->stats.latency_max_us=latency;
+			st->stats.last_done_us=now;
+		}
+		trace_span("scale",scale_start,st->idx,frame_idx);
+		if(st->done)
+			st->done(st->opaque,st->idx,frame.opaque);
+
+		std::lock_guard<std::mutex> guard(sched->pending_lock);
+		trace_counter("frames in flight",sched->pending-1);
+		if(--sched->pending==0)
+			sched->pending_cond.notify_all();
+	}
+	//Back of our own queue if there is more, so other streams get a turn
+	std::unique_lock<std::mutex> guard(st->lock);
+	if(st->frames.empty()){
+		st->scheduled=0;
+		return;
+	}
+	guard.unlock();
+	push_stream(sched,worker_idx,st);
+}
+
+static void worker_thread(StreamScheduler *sched,int worker_idx)
+{
+	trace_thread_name("stream worker",worker_idx);
+	while(1){
+		Stream *st=pop_stream(sched,worker_idx);
+		if(st){
+			run_stream(sched,worker_idx,st);
+			continue;
+		}
+		std::unique_lock<std::mutex> guard(sched->idle_lock);
+		while(sched->queued.load()<=0&&!sched->exit)
+			sched->idle_cond.wait(guard);
+		if(sched->queued.load()<=0&&sched->exit)
+			break;
+	}
+}
+
+StreamScheduler *stream_sched_alloc(int nb_threads,int quantum,SwsCache *cache)
+{
+	StreamScheduler *sched=new StreamScheduler;
+	if(nb_threads<=0)
+		nb_threads=std::thread::hardware_concurrency();
+	if(nb_threads<=0)
+		nb_threads=1;
+	sched->cache=cache;
+	sched->quantum=quantum>0?quantum:1;
+	sched->nb_threads=nb_threads;
+	sched->next_worker=0;
+	sched->queued=0;
+	sched->exit=0;
+	sched->pending=0;
+	sched->workers=new Worker[nb_threads];
+	sched->threads=new std::thread[nb_threads];
+	for(int i=0;i<nb_threads;i++)
+		sched->threads[i]=std::thread(worker_thread,sched,i);
+	return sched;
+}
+
+void stream_sched_free(StreamScheduler **sched)
+{
+	StreamScheduler *s=*sched;
+	if(!s)
+		return;
+	stream_sched_wait(s);
+	{
+		std::lock_guard<std::mutex> guard(s->idle_lock);
+		s->exit=1;
+		s->idle_cond.notify_all();
+	}
+	for(int i=0;i<s->nb_threads;i++)
+		s->threads[i].join();
+	for(size_t i=0;i<s->streams.size();i++){
+		sws_cache_release(s->cache,s->streams[i]->ctx);
+		delete s->streams[i];
+	}
+	delete[] s->threads;
+	delete[] s->workers;
+	delete s;
+	*sched=NULL;
+}
+
+int stream_sched_nb_threads(StreamScheduler *sched)
+{
+	return sched->nb_threads;
+}
+
+int stream_sched_add_stream(StreamScheduler *sched,const SwsCacheKey *key,
+							StreamFrameDone done,void *opaque)
+{
+	struct SwsContext *ctx=sws_cache_acquire(sched->cache,key);
+	if(!ctx)
+		return -1;
+	Stream *st=new Stream;
+	st->ctx=ctx;
+	st->src_h=key->src_h;
+	st->done=done;
+	st->opaque=opaque;
+	st->scheduled=0;
+	memset(&st->stats,0,sizeof(st->stats));
+	std::lock_guard<std::mutex> guard(sched->streams_lock);
+	st->idx=(int)sched->streams.size();
+	sched->streams.push_back(st);
+	return st->idx;
+}
+
+int stream_sched_submit(StreamScheduler *sched,int stream_idx,
+						uint8_t *const src_data[4],const int src_linesize[4],
+						uint8_t *const dst_data[4],const int dst_linesize[4],void *frame_opaque)
+{
+	StreamFrame frame;
+	Stream *st;
+	int wake;
+	{
+		std::lock_guard<std::mutex> guard(sched->streams_lock);
+		if(stream_idx<0||stream_idx>=(int)sched->streams.size())
+			return -1;
+		st=sched->streams[stream_idx];
+	}
+	for(int i=0;i<4;i++){
+		frame.src_data[i]=src_data[i];
+		frame.src_linesize[i]=src_linesize[i];
+		frame.dst_data[i]=dst_data[i];
+		frame.dst_linesize[i]=dst_linesize[i];
+	}
+	frame.opaque=frame_opaque;
+	frame.submit_time=av_gettime();
+	{
+		std::lock_guard<std::mutex> guard(sched->pending_lock);
+		sched->pending++;
+		trace_counter("frames in flight",sched->pending);
+	}
+	{
+		std::lock_guard<std::mutex> guard(st->lock);
+		if(!st->stats.first_submit_us)
+			st->stats.first_submit_us=frame.submit_time;
+		st->frames.push_back(frame);
+		wake=!st->scheduled;
+		st->scheduled=1;
+	}
+	if(wake)
+		push_stream(sched,sched->next_worker++%sched->nb_threads,st);
+	return 0;
+}
+
+void stream_sched_wait(StreamScheduler *sched)
+{
+	std::unique_lock<std::mutex> guard(sched->pending_lock);
+	while(sched->pending)
+		sched->pending_cond.wait(guard);
+}
+
+void stream_sched_get_stats(StreamScheduler *sched,int stream_idx,StreamStats *stats)
+{
+	Stream *st;
+	{
+		std::lock_guard<std::mutex> guard(sched->streams_lock);
+		st=sched->streams[stream_idx];
+	}
+	std::lock_guard<std::mutex> guard(st->lock);
+	*stats=st->stats;
+}
+
+//-streams mode --------------------------------------------------------
+
+//Frames in flight per stream
+#define STREAM_SLOTS 4
+
+typedef struct StreamSlot{
+	FrameBuffer src,dst;
+}StreamSlot;
+
+typedef struct StreamJob{
+	const JobSpec *job;
+	FillPlanesFunc fill;
+	WritePlanesFunc write;
+	int idx;
+	FILE *src_file,*dst_file;
+	int eof;
+	int failed;               //Set by the reader or the done callback
+	int64_t submitted;        //Guarded by StreamsState.lock
+	int64_t completed;        //Guarded by StreamsState.lock
+	StreamSlot slots[STREAM_SLOTS];
+}StreamJob;
+
+typedef struct StreamsState{
+	std::mutex lock;
+	std::condition_variable slot_cond;
+	StreamJob *streams;
+}StreamsState;
+
+static void stream_frame_done(void *opaque,int stream_idx,void *frame_opaque)
+{
+	StreamsState *state=(StreamsState *)opaque;
+	StreamJob *sj=&state->streams[stream_idx];
+	StreamSlot *slot=(StreamSlot *)frame_opaque;
+	int64_t write_start=trace_now();
+	//Frames of one stream complete in order, so the file needs no lock
+	PROBE_IO_SUBMIT(PROBE_IO_WRITE);
+	int ret=sj->write(sj->dst_file,slot->dst.data,sj->job->dst_w,sj->job->dst_h);
+	PROBE_IO_COMPLETE(PROBE_IO_WRITE,ret);
+	std::lock_guard<std::mutex> guard(state->lock);
+	if(ret<0)
+		sj->failed=1;
+	trace_span("write",write_start,stream_idx,sj->completed);
+	PROBE_FRAME_END(stream_idx,sj->completed,ret<0?-1:0);
+	sj->completed++;
+	state->slot_cond.notify_one();
+}
+
+int streams_main(const char *manifest,int nb_threads)
+{
+	JobSpec *jobs=NULL;
+	StreamsState state;
+	StreamScheduler *sched=NULL;
+	SwsCache *cache=NULL;
+	uint8_t *temp_buffer=NULL;
+	int nb_streams,temp_size=0,active,ret=-1;
+	int64_t start,time_us,frames=0;
+
+	state.streams=NULL;
+	nb_streams=read_manifest(manifest,&jobs);
+	if(nb_streams<0)
+		return -1;
+	if(check_no_pal8(jobs,nb_streams)<0){
+		free(jobs);
+		return -1;
+	}
+	if(nb_streams==0){
+		printf("Streams: no jobs in %s\n",manifest);
+		free(jobs);
+		return 0;
+	}
+
+	//Every stream holds its context for the whole run
+	cache=sws_cache_alloc(nb_streams);
+	state.streams=(StreamJob *)calloc(nb_streams,sizeof(StreamJob));
+	if(!cache||!state.streams){
+		printf("Could not allocate stream state\n");
+		goto end;
+	}
+	for(int i=0;i<nb_streams;i++){
+		for(int k=0;k<STREAM_SLOTS;k++){
+			frame_buffer_init(&state.streams[i].slots[k].src);
+			frame_buffer_init(&state.streams[i].slots[k].dst);
+		}
+	}
+	sched=stream_sched_alloc(nb_threads,1,cache);
+
+	for(int i=0;i<nb_streams;i++){
+		StreamJob *sj=&state.streams[i];
+		const JobSpec *job=&jobs[i];
+		SwsCacheKey key;
+		int size=raw_frame_size(job->src_pixfmt,job->src_w,job->src_h);
+		sj->job=job;
+		sj->fill=get_fill_planes(job->src_pixfmt);
+		sj->write=get_write_planes(job->dst_pixfmt);
+		sj->src_file=fopen(job->input,"rb");
+		if(!sj->src_file){
+			printf("Could not open %s\n",job->input);
+			goto end;
+		}
+		sj->dst_file=fopen(job->output,"wb");
+		if(!sj->dst_file){
+			printf("Could not open %s\n",job->output);
+			goto end;
+		}
+		for(int k=0;k<STREAM_SLOTS;k++){
+			if(frame_buffer_ensure(&sj->slots[k].src,job->src_w,job->src_h,job->src_pixfmt)<0||
+				frame_buffer_ensure(&sj->slots[k].dst,job->dst_w,job->dst_h,job->dst_pixfmt)<0){
+				printf("Could not allocate image\n");
+				goto end;
+			}
+		}
+		sws_cache_key_init(&key,job->src_w,job->src_h,job->src_pixfmt,job->dst_w,job->dst_h,job->dst_pixfmt);
+		key.flags=job->flags;
+		sj->idx=stream_sched_add_stream(sched,&key,stream_frame_done,&state);
+		if(sj->idx<0){
+			printf("Could not initialize context for stream %d\n",i);
+			goto end;
+		}
+		if(size>temp_size)
+			temp_size=size;
+	}
+	temp_buffer=(uint8_t *)malloc(temp_size);
+	if(!temp_buffer){
+		printf("Could not allocate stream state\n");
+		goto end;
+	}
+
+	printf("Streams: %d streams, %d threads\n",nb_streams,stream_sched_nb_threads(sched));
+	start=av_gettime();
+	//Feed the streams round-robin, one frame each while they have a free slot
+	do{
+		int progress=0;
+		active=0;
+		for(int i=0;i<nb_streams;i++){
+			StreamJob *sj=&state.streams[i];
+			const JobSpec *job=sj->job;
+			int size=raw_frame_size(job->src_pixfmt,job->src_w,job->src_h);
+			size_t n;
+			int64_t read_start;
+			if(sj->eof)
+				continue;
+			{
+				std::lock_guard<std::mutex> guard(state.lock);
+				if(sj->submitted-sj->completed>=STREAM_SLOTS){
+					active++;
+					continue;
+				}
+			}
+			PROBE_FRAME_START(sj->idx,sj->submitted);
+			read_start=trace_now();
+			PROBE_IO_SUBMIT(PROBE_IO_READ);
+			n=fread(temp_buffer,1,size,sj->src_file);
+			PROBE_IO_COMPLETE(PROBE_IO_READ,(int64_t)n);
+			if(n!=(size_t)size){
+				if(n>0||ferror(sj->src_file)){
+					std::lock_guard<std::mutex> guard(state.lock);
+					printf("%s: truncated frame %lld\n",job->input,(long long)sj->submitted);
+					sj->failed=1;
+				}
+				PROBE_FRAME_END(sj->idx,sj->submitted,n>0||ferror(sj->src_file)?-1:1);
+				sj->eof=1;
+				continue;
+			}
+			active++;
+			StreamSlot *slot=&sj->slots[sj->submitted%STREAM_SLOTS];
+			sj->fill(slot->src.data,temp_buffer,job->src_w,job->src_h);
+			trace_span("read",read_start,sj->idx,sj->submitted);
+			//Count it first, the frame may be done before submit returns
+			{
+				std::lock_guard<std::mutex> guard(state.lock);
+				sj->submitted++;
+			}
+			stream_sched_submit(sched,sj->idx,slot->src.data,slot->src.linesize,
+				slot->dst.data,slot->dst.linesize,slot);
+			progress=1;
+		}
+		if(active&&!progress){
+			//Every open stream has all its slots in flight
+			std::unique_lock<std::mutex> guard(state.lock);
+			state.slot_cond.wait(guard,[&]{
+				for(int i=0;i<nb_streams;i++){
+					StreamJob *sj=&state.streams[i];
+					if(!sj->eof&&sj->submitted-sj->completed<STREAM_SLOTS)
+						return true;
+				}
+				return false;
+			});
+		}
+	}while(active);
+	stream_sched_wait(sched);
+	time_us=av_gettime()-start;
+
+	ret=0;
+	for(int i=0;i<nb_streams;i++){
+		StreamJob *sj=&state.streams[i];
+		StreamStats st;
+		stream_sched_get_stats(sched,sj->idx,&st);
+		double sec=st.last_done_us>st.first_submit_us?(st.last_done_us-st.first_submit_us)/1000000.0:1e-6;
+		printf("Stream %5d %s -> %s: ",i,jobs[i].input,jobs[i].output);
+		//Buffered data is flushed here, so a full disk may only show now
+		if(fclose(sj->dst_file)!=0)
+			sj->failed=1;
+		sj->dst_file=NULL;
+		if(sj->failed||st.frames==0){
+			printf("FAILED\n");
+			ret=1;
+			continue;
+		}
+		printf("%6lld frames %9.1f fps latency avg %8.2f ms max %8.2f ms\n",
+			(long long)st.frames,st.frames/sec,st.latency_sum_us/1000.0/st.frames,st.latency_max_us/1000.0);
+		frames+=st.frames;
+	}
+	printf("Total: %lld frames in %.3f s, %.1f fps\n",(long long)frames,time_us/1000000.0,
+		frames/(time_us>0?time_us/1000000.0:1e-6));
+
+end:
+	//Joins the workers and gives the contexts back before the buffers go away
+	stream_sched_free(&sched);
+	if(state.streams){
+		for(int i=0;i<nb_streams;i++){
+			StreamJob *sj=&state.streams[i];
+			for(int k=0;k<STREAM_SLOTS;k++){
+				frame_buffer_free(&sj->slots[k].src);
+				frame_buffer_free(&sj->slots[k].dst);
+			}
+			if(sj->src_file)
+				fclose(sj->src_file);
+			if(sj->dst_file)
+				fclose(sj->dst_file);
+		}
+	}
+	sws_cache_free(&cache);
+	free(state.streams);
+	free(temp_buffer);
+	free(jobs);
+	return ret;
+}
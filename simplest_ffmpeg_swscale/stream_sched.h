@@ -0,0 +1,56 @@
+/**
+ * Multi-stream scheduler
+ *
+ * Multiplexes many independent streams over a fixed set of workers. Each
+ * stream owns its SwsContext and is run by at most one worker at a time, so
+ * its frames are converted and completed in submission order. A runnable
+ * stream sits in one worker's queue; idle workers steal from the others.
+ * After 'quantum' frames a stream goes to the back of the queue, so busy
+ * streams cannot starve the rest.
+ */
+
+#ifndef STREAM_SCHED_H
+#define STREAM_SCHED_H
+
+#include <stdint.h>
+
+#include "sws_cache.h"
+
+typedef struct StreamScheduler StreamScheduler;
+
+//Called on the worker after a frame has been converted, in frame order per stream
+typedef void (*StreamFrameDone)(void *opaque,int stream_idx,void *frame_opaque);
+
+typedef struct StreamStats{
+	int64_t frames;
+	int64_t latency_sum_us;    //Submit to done
+	int64_t latency_max_us;
+	int64_t first_submit_us;
+	int64_t last_done_us;
+}StreamStats;
+
+//nb_threads<=0: one per CPU core. Contexts come from cache.
+StreamScheduler *stream_sched_alloc(int nb_threads,int quantum,SwsCache *cache);
+//Waits for pending frames first
+void stream_sched_free(StreamScheduler **sched);
+
+int stream_sched_nb_threads(StreamScheduler *sched);
+
+//Returns the stream index, <0 on error
+int stream_sched_add_stream(StreamScheduler *sched,const SwsCacheKey *key,
+							StreamFrameDone done,void *opaque);
+
+//Queue one frame. The planes must stay valid until done is called.
+int stream_sched_submit(StreamScheduler *sched,int stream_idx,
+						uint8_t *const src_data[4],const int src_linesize[4],
+						uint8_t *const dst_data[4],const int dst_linesize[4],void *frame_opaque);
+
+//Block until every submitted frame is done
+void stream_sched_wait(StreamScheduler *sched);
+
+void stream_sched_get_stats(StreamScheduler *sched,int stream_idx,StreamStats *stats);
+
+//-streams mode: every manifest job (see batch.h) is a stream
+int streams_main(const char *manifest,int nb_threads);
+
+#endif
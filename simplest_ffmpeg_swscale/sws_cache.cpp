@@ -0,0 +1,232 @@
+/**
+ * SwsContext cache
+ *
+ * A small array searched linearly: caches hold tens of contexts at most,
+ * and a lookup is nothing next to one sws_scale() call.
+ * An entry with ctx==NULL is either being created (in_use) or empty.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mutex>
+#include <condition_variable>
+
+#include "sws_cache.h"
+#include "alloc_track.h"
+#include "probes.h"
+
+typedef struct SwsCacheEntry{
+	SwsCacheKey key;
+	struct SwsContext *ctx;  //NULL while being created, or empty slot
+	int in_use;
+	int64_t last_used;
+}SwsCacheEntry;
+
+struct SwsCache{
+	std::mutex lock;
+	std::condition_variable release_cond;  //A context was released or created
+	SwsCacheEntry *entries;
+	int max_entries;
+	int nb_entries;
+	int64_t tick;
+	SwsCacheStats stats;
+};
+
+static int key_equal(const SwsCacheKey *a,const SwsCacheKey *b)
+{
+	return a->src_w==b->src_w&&a->src_h==b->src_h&&a->src_pixfmt==b->src_pixfmt&&
+		a->src_range==b->src_range&&a->dst_w==b->dst_w&&a->dst_h==b->dst_h&&
+		a->dst_pixfmt==b->dst_pixfmt&&a->dst_range==b->dst_range&&
+		a->flags==b->flags&&a->src_colorspace==b->src_colorspace&&
+		a->dst_colorspace==b->dst_colorspace;
+}
+
+//Whether sws_getCachedContext() has to rebuild a context made for old to
+//serve key: range and colorspace are only set on top of it
+static int needs_rebuild(const SwsCacheKey *old,const SwsCacheKey *key)
+{
+	return old->src_w!=key->src_w||old->src_h!=key->src_h||old->src_pixfmt!=key->src_pixfmt||
+		old->dst_w!=key->dst_w||old->dst_h!=key->dst_h||old->dst_pixfmt!=key->dst_pixfmt||
+		old->flags!=key->flags;
+}
+
+//Create ctx for key, or reinit an existing one made for old_key
+//(sws_getCachedContext() keeps it as is when only range or colorspace differ)
+static struct SwsContext *init_context(struct SwsContext *ctx,const SwsCacheKey *old_key,
+									   const SwsCacheKey *key)
+{
+	AllocScope scope(ALLOC_TAG_SWSCALE);
+	struct SwsContext *old_ctx=ctx;
+	ctx=sws_getCachedContext(ctx,key->src_w,key->src_h,key->src_pixfmt,
+		key->dst_w,key->dst_h,key->dst_pixfmt,key->flags,NULL,NULL,NULL);
+	if(!ctx)
+		return NULL;
+	//Only report contexts that were actually built, not reused ones
+	if(ctx!=old_ctx||needs_rebuild(old_key,key))
+		PROBE_CONTEXT_CREATE(ctx,key->src_w,key->src_h,key->src_pixfmt,key->dst_w,key->dst_h,key->dst_pixfmt,key->flags);
+	//Returns -1 for YUV output, where the tables are not used; not an error
+	sws_setColorspaceDetails(ctx,sws_getCoefficients(key->src_colorspace),key->src_range,
+		sws_getCoefficients(key->dst_colorspace),key->dst_range,0,1<<16,1<<16);
+	return ctx;
+}
+
+void sws_cache_key_init(SwsCacheKey *key,int src_w,int src_h,AVPixelFormat src_pixfmt,
+						int dst_w,int dst_h,AVPixelFormat dst_pixfmt)
+{
+	memset(key,0,sizeof(*key));
+	key->src_w=src_w;
+	key->src_h=src_h;
+	key->src_pixfmt=src_pixfmt;
+	key->src_range=1;
+	key->dst_w=dst_w;
+	key->dst_h=dst_h;
+	key->dst_pixfmt=dst_pixfmt;
+	key->dst_range=1;
+	key->flags=SWS_BICUBIC;
+	key->src_colorspace=SWS_CS_ITU601;
+	key->dst_colorspace=SWS_CS_ITU601;
+}
+
+SwsCache *sws_cache_alloc(int max_entries)
+{
+	SwsCache *cache;
+	if(max_entries<1)
+		return NULL;
+	AllocScope scope(ALLOC_TAG_SWSCALE);
+	cache=new SwsCache;
+	cache->entries=(SwsCacheEntry *)calloc(max_entries,sizeof(SwsCacheEntry));
+	if(!cache->entries){
+		delete cache;
+		return NULL;
+	}
+	cache->max_entries=max_entries;
+	cache->nb_entries=0;
+	cache->tick=0;
+	memset(&cache->stats,0,sizeof(cache->stats));
+	return cache;
+}
+
+void sws_cache_free(SwsCache **cache)
+{
+	SwsCache *c=*cache;
+	if(!c)
+		return;
+	AllocScope scope(ALLOC_TAG_SWSCALE);
+	for(int i=0;i<c->nb_entries;i++){
+		if(c->entries[i].in_use)
+			printf("SwsCache: context still in use at free\n");
+		sws_freeContext(c->entries[i].ctx);
+	}
+	free(c->entries);
+	delete c;
+	*cache=NULL;
+}
+
+struct SwsContext *sws_cache_acquire(SwsCache *cache,const SwsCacheKey *key)
+{
+	SwsCacheEntry *entry=NULL;
+	struct SwsContext *ctx=NULL;
+	SwsCacheKey old_key;     //What the evicted context was made for
+	{
+		std::unique_lock<std::mutex> guard(cache->lock);
+		int waited=0;
+		while(1){
+			SwsCacheEntry *lru=NULL,*empty=NULL;
+			int in_flight=0;
+			for(int i=0;i<cache->nb_entries;i++){
+				SwsCacheEntry *e=&cache->entries[i];
+				if(e->in_use){
+					//Same key still being created: its owner may be done with it soon
+					if(!e->ctx&&key_equal(&e->key,key))
+						in_flight=1;
+					continue;
+				}
+				if(!e->ctx){
+					empty=e;
+					continue;
+				}
+				if(key_equal(&e->key,key)){
+					e->in_use=1;
+					e->last_used=++cache->tick;
+					cache->stats.hits++;
+					return e->ctx;
+				}
+				if(!lru||e->last_used<lru->last_used)
+					lru=e;
+			}
+			if(!in_flight){
+				if(empty){
+					entry=empty;
+				}else if(cache->nb_entries<cache->max_entries){
+					entry=&cache->entries[cache->nb_entries++];
+					entry->ctx=NULL;
+				}else if(lru){
+					entry=lru;
+					cache->stats.evictions++;
+				}
+			}
+			if(entry)
+				break;
+			//Every context is in use, or ours is being built: wait for a release
+			if(!waited)
+				cache->stats.waits++;
+			waited=1;
+			cache->release_cond.wait(guard);
+		}
+		cache->stats.misses++;
+		ctx=entry->ctx;
+		old_key=entry->key;
+		entry->ctx=NULL;
+		entry->key=*key;
+		entry->in_use=1;
+		entry->last_used=++cache->tick;
+	}
+
+	//Filter init is the slow part, keep it out of the lock
+	ctx=init_context(ctx,&old_key,key);
+
+	{
+		std::lock_guard<std::mutex> guard(cache->lock);
+		//On failure the slot is left empty for the next miss
+		entry->ctx=ctx;
+		if(!ctx)
+			entry->in_use=0;
+	}
+	cache->release_cond.notify_all();
+	return ctx;
+}
+
+void sws_cache_release(SwsCache *cache,struct SwsContext *ctx)
+{
+	if(!ctx)
+		return;
+	{
+		std::lock_guard<std::mutex> guard(cache->lock);
+		for(int i=0;i<cache->nb_entries;i++){
+			if(cache->entries[i].ctx==ctx){
+				cache->entries[i].in_use=0;
+				break;
+			}
+		}
+	}
+	cache->release_cond.notify_all();
+}
+
+void sws_cache_get_stats(SwsCache *cache,SwsCacheStats *stats)
+{
+	std::lock_guard<std::mutex> guard(cache->lock);
+	*stats=cache->stats;
+	stats->entries=0;
+	stats->in_use=0;
+	for(int i=0;i<cache->nb_entries;i++){
+		stats->entries+=cache->entries[i].ctx!=NULL;
+		stats->in_use+=cache->entries[i].in_use;
+	}
+}
+
+double sws_cache_hit_rate(const SwsCacheStats *stats)
+{
+	int64_t total=stats->hits+stats->misses;
+	return total?(double)stats->hits/total:0;
+}
@@ -0,0 +1,81 @@
+/**
+ * SwsContext cache
+ *
+ * Keeps initialized SwsContexts keyed by their conversion parameters so
+ * that jobs whose sizes or formats change do not pay for
+ * sws_init_context() (filter generation) every time.
+ *
+ * A context is handed out for exclusive use by sws_cache_acquire() and
+ * given back with sws_cache_release(). Idle contexts are reused on a hit
+ * and the least recently used idle one is recycled through
+ * sws_getCachedContext() on a miss once the cache is full. At most
+ * max_entries contexts ever exist: when all of them are in use, or the
+ * wanted key is being created by another thread, sws_cache_acquire()
+ * waits for a release. A caller must therefore never hold max_entries
+ * contexts while acquiring another one. The cache is thread safe.
+ */
+
+#ifndef SWS_CACHE_H
+#define SWS_CACHE_H
+
+#include <stdint.h>
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+extern "C"
+{
+#include "libswscale/swscale.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libswscale/swscale.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+typedef struct SwsCacheKey{
+	int src_w,src_h;
+	AVPixelFormat src_pixfmt;
+	int src_range;          //'0' for MPEG (Y:0-235);'1' for JPEG (Y:0-255)
+	int dst_w,dst_h;
+	AVPixelFormat dst_pixfmt;
+	int dst_range;
+	int flags;              //SWS_BICUBIC, SWS_BILINEAR...
+	int src_colorspace;     //SWS_CS_ITU601, SWS_CS_ITU709...
+	int dst_colorspace;
+}SwsCacheKey;
+
+typedef struct SwsCacheStats{
+	int64_t hits;
+	int64_t misses;
+	int64_t evictions;      //Idle contexts recycled to stay within max_entries
+	int64_t waits;          //Acquires that had to wait for a release
+	int entries;            //Contexts currently kept by the cache
+	int in_use;             //Contexts currently acquired
+}SwsCacheStats;
+
+typedef struct SwsCache SwsCache;
+
+//Fill a key with the defaults used by main(): full range, ITU601, bicubic
+void sws_cache_key_init(SwsCacheKey *key,int src_w,int src_h,AVPixelFormat src_pixfmt,
+						int dst_w,int dst_h,AVPixelFormat dst_pixfmt);
+
+SwsCache *sws_cache_alloc(int max_entries);
+void sws_cache_free(SwsCache **cache);
+
+//Return a context for key, for exclusive use until sws_cache_release(). NULL on failure.
+struct SwsContext *sws_cache_acquire(SwsCache *cache,const SwsCacheKey *key);
+void sws_cache_release(SwsCache *cache,struct SwsContext *ctx);
+
+void sws_cache_get_stats(SwsCache *cache,SwsCacheStats *stats);
+//Hits / (hits + misses), 0 before the first lookup
+double sws_cache_hit_rate(const SwsCacheStats *stats);
+
+#endif
@@ -0,0 +1,188 @@
+/**
+ * Thread scaling benchmark
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <thread>
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+extern "C"
+{
+#include "libavutil/imgutils.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/time.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/time.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+#include "thread_bench.h"
+#include "thread_pool.h"
+#include "pattern_source.h"
+#include "batch.h"
+
+static const int bench_sizes[][2]={
+	{640,360},{1280,720},{1920,1080},{3840,2160}
+};
+
+//Frames of the strong scaling run, per worker in the weak one: about the
+//same number of pixels at every size
+#define BENCH_PIXELS 100000000
+#define BENCH_MIN_FRAMES 4
+
+//Frames drawn once and shared read-only by the workers
+#define BENCH_CACHED_FRAMES 8
+
+typedef struct BenchWorker{
+	Scaler scaler;
+	Frame dst;
+	const PatternSource *source;
+	int first;              //first cached frame, so the workers do not run in lockstep
+	int frames;
+	int ret;
+}BenchWorker;
+
+static void run_worker(void *arg,int worker_idx)
+{
+	BenchWorker *w=(BenchWorker *)arg;
+	w->ret=0;
+	for(int i=0;i<w->frames;i++){
+		if(w->scaler.scale(w->source->cached(w->first+i),w->dst)<0){
+			w->ret=-1;
+			break;
+		}
+	}
+}
+
+//Run every worker once on pool, time in microseconds or <0 on error
+static int64_t run_workers(ThreadPool *pool,std::vector<BenchWorker> &workers)
+{
+	int64_t start=av_gettime();
+	for(size_t i=0;i<workers.size();i++)
+		thread_pool_submit(pool,run_worker,&workers[i]);
+	thread_pool_wait(pool);
+	for(size_t i=0;i<workers.size();i++){
+		if(workers[i].ret<0)
+			return -1;
+	}
+	return av_gettime()-start;
+}
+
+//Time total_frames split over nb_threads workers (per_worker=0), or
+//per_worker frames on each of them
+static int64_t time_threads(const PatternSource &source,AVPixelFormat dst_pixfmt,int flags,
+							int nb_threads,int total_frames,int per_worker)
+{
+	const Frame &src=source.cached(0);
+	std::vector<BenchWorker> workers(nb_threads);
+	ThreadPool *pool=thread_pool_alloc(nb_threads);
+	int64_t time_us=-1;
+
+	if(!pool)
+		return -1;
+	for(int i=0;i<nb_threads;i++){
+		BenchWorker &w=workers[i];
+		if(w.dst.alloc(src.width(),src.height(),dst_pixfmt)<0||
+			w.scaler.init(src.width(),src.height(),src.pixfmt(),src.width(),src.height(),dst_pixfmt,flags)<0)
+			goto end;
+		w.source=&source;
+		w.first=i;
+		w.frames=1;
+	}
+	//Warm up: the first call sets up each scaler, and the destination is
+	//first touched by the thread that writes it
+	if(run_workers(pool,workers)<0)
+		goto end;
+	for(int i=0;i<nb_threads;i++)
+		workers[i].frames=per_worker?per_worker:total_frames/nb_threads+(i<total_frames%nb_threads);
+	time_us=run_workers(pool,workers);
+
+end:
+	thread_pool_free(&pool);
+	return time_us;
+}
+
+static double gbytes_per_sec(int64_t frames,int frame_bytes,int64_t time_us)
+{
+	return time_us>0?(double)frames*frame_bytes/time_us/1000.0:0;
+}
+
+int thread_bench(AVPixelFormat src_pixfmt,AVPixelFormat dst_pixfmt,int flags,int max_threads)
+{
+	const int nb_sizes=sizeof(bench_sizes)/sizeof(bench_sizes[0]);
+	std::vector<int> counts;
+	PatternSpec spec;
+
+	if(max_threads<=0)
+		max_threads=std::thread::hardware_concurrency();
+	if(max_threads<=0)
+		max_threads=1;
+	//1, 2, 4... and the maximum
+	for(int n=1;n<max_threads;n*=2)
+		counts.push_back(n);
+	counts.push_back(max_threads);
+	pattern_preset(&spec,"movingbars");
+
+	printf("Thread scaling: %s -> %s %s, 1 to %d threads\n",av_get_pix_fmt_name(src_pixfmt),
+		av_get_pix_fmt_name(dst_pixfmt),sws_flags_name(flags),max_threads);
+	for(int s=0;s<nb_sizes;s++){
+		int w=bench_sizes[s][0],h=bench_sizes[s][1];
+		int frames=BENCH_PIXELS/(w*h)>BENCH_MIN_FRAMES?BENCH_PIXELS/(w*h):BENCH_MIN_FRAMES;
+		int frame_bytes=av_image_get_buffer_size(src_pixfmt,w,h,1)+av_image_get_buffer_size(dst_pixfmt,w,h,1);
+		int64_t strong_1=0,weak_1=0;
+		double peak_bw=0;
+		int peak_threads=1;
+		PatternSource source;
+
+		if(source.open(spec,w,h,src_pixfmt,BENCH_CACHED_FRAMES,0)<0){
+			printf("Could not draw frames in %s %dx%d\n",av_get_pix_fmt_name(src_pixfmt),w,h);
+			return -1;
+		}
+		printf("\n%dx%d: strong %d frames in total, weak %d frames per thread\n",w,h,frames,frames);
+		printf("threads | strong ms/frame speedup  effic.   GB/s | weak ms/frame  effic.   GB/s\n");
+		for(size_t c=0;c<counts.size();c++){
+			int n=counts[c];
+			int64_t strong=time_threads(source,dst_pixfmt,flags,n,frames,0);
+			int64_t weak=time_threads(source,dst_pixfmt,flags,n,0,frames);
+			double strong_bw,weak_bw;
+			if(strong<0||weak<0){
+				printf("Could not convert %s -> %s at %dx%d\n",av_get_pix_fmt_name(src_pixfmt),
+					av_get_pix_fmt_name(dst_pixfmt),w,h);
+				return -1;
+			}
+			if(n==1){
+				strong_1=strong;
+				weak_1=weak;
+			}
+			strong_bw=gbytes_per_sec(frames,frame_bytes,strong);
+			weak_bw=gbytes_per_sec((int64_t)frames*n,frame_bytes,weak);
+			//Strong: t1/tn against n. Weak: the time should not grow at all.
+			printf("%7d | %15.3f %6.2fx %6.1f%% %6.2f | %13.3f %6.1f%% %6.2f\n",n,
+				strong/1000.0/frames,strong>0?(double)strong_1/strong:0,
+				strong>0?100.0*strong_1/strong/n:0,strong_bw,
+				weak/1000.0/((int64_t)frames*n),weak>0?100.0*weak_1/weak:0,weak_bw);
+			if(weak_bw>peak_bw){
+				peak_bw=weak_bw;
+				peak_threads=n;
+			}
+		}
+		printf("Peak bandwidth %.2f GB/s at %d threads\n",peak_bw,peak_threads);
+	}
+	return 0;
+}
@@ -0,0 +1,44 @@
+/**
+ * Thread scaling benchmark
+ *
+ * Converts generated frames from RAM (see pattern_source.h) on 1..N
+ * workers of a ThreadPool, each with its own Scaler, the way batch mode
+ * runs jobs side by side. For every source resolution it measures
+ *
+ *   strong scaling: a fixed number of frames shared by the workers
+ *   weak scaling:   a fixed number of frames per worker
+ *
+ * and reports speedup, efficiency and the memory bandwidth the conversion
+ * moves (source read plus destination written, as batch mode counts it).
+ * When more workers stop adding bandwidth the machine is saturated, which
+ * bounds how many cores a converter container can use.
+ */
+
+#ifndef THREAD_BENCH_H
+#define THREAD_BENCH_H
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+extern "C"
+{
+#include "libavutil/pixfmt.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libavutil/pixfmt.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+//src_pixfmt -> dst_pixfmt at the same size, for several sizes.
+//max_threads<=0: one per CPU core
+int thread_bench(AVPixelFormat src_pixfmt,AVPixelFormat dst_pixfmt,int flags,int max_threads);
+
+#endif
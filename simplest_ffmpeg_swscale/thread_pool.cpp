@@ -0,0 +1,107 @@
+/**
+ * Fixed size thread pool
+ */
+
+#include <stddef.h>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "thread_pool.h"
+#include "trace.h"
+
+typedef struct ThreadPoolTask{
+	ThreadPoolFunc func;
+	void *arg;
+}ThreadPoolTask;
+
+struct ThreadPool{
+	std::mutex lock;
+	std::condition_variable task_cond;  //New task or exit
+	std::condition_variable done_cond;  //A task finished
+	std::deque<ThreadPoolTask> tasks;
+	int nb_threads;
+	std::thread *threads;
+	int pending;                        //Queued plus running
+	int exit;
+};
+
+static void worker(ThreadPool *pool,int worker_idx)
+{
+	trace_thread_name("pool worker",worker_idx);
+	std::unique_lock<std::mutex> guard(pool->lock);
+	while(1){
+		while(pool->tasks.empty()&&!pool->exit)
+			pool->task_cond.wait(guard);
+		if(pool->tasks.empty())
+			break;
+		ThreadPoolTask task=pool->tasks.front();
+		pool->tasks.pop_front();
+		guard.unlock();
+		task.func(task.arg,worker_idx);
+		guard.lock();
+		trace_counter("pool tasks",pool->pending-1);
+		if(--pool->pending==0)
+			pool->done_cond.notify_all();
+	}
+}
+
+ThreadPool *thread_pool_alloc(int nb_threads)
+{
+	ThreadPool *pool=new ThreadPool;
+	if(nb_threads<=0)
+		nb_threads=std::thread::hardware_concurrency();
+	if(nb_threads<=0)
+		nb_threads=1;
+	pool->nb_threads=nb_threads;
+	pool->pending=0;
+	pool->exit=0;
+	pool->threads=new std::thread[nb_threads];
+	for(int i=0;i<nb_threads;i++)
+		pool->threads[i]=std::thread(worker,pool,i);
+	return pool;
+}
+
+void thread_pool_free(ThreadPool **pool)
+{
+	ThreadPool *p=*pool;
+	if(!p)
+		return;
+	{
+		std::lock_guard<std::mutex> guard(p->lock);
+		p->exit=1;
+	}
+	p->task_cond.notify_all();
+	for(int i=0;i<p->nb_threads;i++)
+		p->threads[i].join();
+	delete[] p->threads;
+	delete p;
+	*pool=NULL;
+}
+
+int thread_pool_size(ThreadPool *pool)
+{
+	return pool->nb_threads;
+}
+
+void thread_pool_submit(ThreadPool *pool,ThreadPoolFunc func,void *arg)
+{
+	ThreadPoolTask task;
+	task.func=func;
+	task.arg=arg;
+	{
+		std::lock_guard<std::mutex> guard(pool->lock);
+		pool->tasks.push_back(task);
+		pool->pending++;
+		trace_counter("pool tasks",pool->pending);
+	}
+	pool->task_cond.notify_one();
+}
+
+void thread_pool_wait(ThreadPool *pool)
+{
+	std::unique_lock<std::mutex> guard(pool->lock);
+	while(pool->pending)
+		pool->done_cond.wait(guard);
+}
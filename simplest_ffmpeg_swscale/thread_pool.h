@@ -0,0 +1,27 @@
+/**
+ * Fixed size thread pool
+ *
+ * Tasks are run in submission order by whichever worker is free. Each task
+ * gets the index of the worker running it, so callers can keep per-worker
+ * state (buffers, contexts) without locking.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+typedef void (*ThreadPoolFunc)(void *arg,int worker_idx);
+
+typedef struct ThreadPool ThreadPool;
+
+//nb_threads<=0: one per CPU core
+ThreadPool *thread_pool_alloc(int nb_threads);
+//Wait for the queued tasks, then stop the workers
+void thread_pool_free(ThreadPool **pool);
+
+int thread_pool_size(ThreadPool *pool);
+
+void thread_pool_submit(ThreadPool *pool,ThreadPoolFunc func,void *arg);
+//Block until every submitted task has finished
+void thread_pool_wait(ThreadPool *pool);
+
+#endif
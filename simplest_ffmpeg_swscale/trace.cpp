@@ -0,0 +1,137 @@
+/**
+ * Chrome trace of pipeline activity
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <mutex>
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+extern "C"
+{
+#include "libavutil/time.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libavutil/time.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+#include "trace.h"
+
+static struct{
+	std::mutex lock;
+	FILE *file;               //Set before any thread traces, cleared after
+	int64_t start_time;
+	int nb_events;
+	std::atomic<int> next_tid;
+}trace;
+
+//Track of the calling thread, 0 until it first traces
+static thread_local int trace_tid;
+
+static int thread_tid()
+{
+	if(!trace_tid)
+		trace_tid=++trace.next_tid;
+	return trace_tid;
+}
+
+//Comma between events; call with trace.lock held
+static void begin_event()
+{
+	fputs(trace.nb_events++?",\n":"\n",trace.file);
+}
+
+int trace_open(const char *path)
+{
+	trace_close();
+	trace.file=fopen(path,"w");
+	if(!trace.file){
+		printf("Could not open %s\n",path);
+		return -1;
+	}
+	trace.start_time=av_gettime();
+	trace.nb_events=0;
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[",trace.file);
+	trace_thread_name("main",-1);
+	return 0;
+}
+
+void trace_close(void)
+{
+	std::lock_guard<std::mutex> guard(trace.lock);
+	if(!trace.file)
+		return;
+	fputs("\n]}\n",trace.file);
+	if(fclose(trace.file)!=0)
+		printf("Could not write the trace\n");
+	trace.file=NULL;
+}
+
+int trace_enabled(void)
+{
+	return trace.file!=NULL;
+}
+
+int64_t trace_now(void)
+{
+	return trace.file?av_gettime():0;
+}
+
+void trace_span(const char *name,int64_t start,int job,int64_t frame)
+{
+	if(!trace.file)
+		return;
+	int64_t now=av_gettime();
+	int tid=thread_tid();
+	std::lock_guard<std::mutex> guard(trace.lock);
+	begin_event();
+	fprintf(trace.file,"{\"name\":\"%s\",\"cat\":\"stage\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+		"\"ts\":%lld,\"dur\":%lld,\"args\":{",name,tid,
+		(long long)(start-trace.start_time),(long long)(now-start));
+	if(job>=0)
+		fprintf(trace.file,"\"job\":%d%s",job,frame>=0?",":"");
+	if(frame>=0)
+		fprintf(trace.file,"\"frame\":%lld",(long long)frame);
+	fputs("}}",trace.file);
+}
+
+void trace_counter(const char *name,int64_t value)
+{
+	if(!trace.file)
+		return;
+	int64_t now=av_gettime();
+	std::lock_guard<std::mutex> guard(trace.lock);
+	begin_event();
+	fprintf(trace.file,"{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"ts\":%lld,\"args\":{\"value\":%lld}}",
+		name,(long long)(now-trace.start_time),(long long)value);
+}
+
+void trace_thread_name(const char *name,int idx)
+{
+	if(!trace.file)
+		return;
+	int tid=thread_tid();
+	std::lock_guard<std::mutex> guard(trace.lock);
+	begin_event();
+	fprintf(trace.file,"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"",tid);
+	if(idx>=0)
+		fprintf(trace.file,"%s %d\"}}",name,idx);
+	else
+		fprintf(trace.file,"%s\"}}",name);
+	//Tracks in the order the threads were named
+	begin_event();
+	fprintf(trace.file,"{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"sort_index\":%d}}",
+		tid,tid);
+}
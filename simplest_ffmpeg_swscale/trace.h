@@ -0,0 +1,40 @@
+/**
+ * Chrome trace of pipeline activity
+ *
+ * With -trace out.json in front of any mode, the converter writes a Chrome
+ * trace-event file that chrome://tracing or https://ui.perfetto.dev opens:
+ * one track per thread, a span per frame for each stage (read, scale,
+ * write) and counter tracks for queue depths (jobs waiting in the thread
+ * pool, streams queued and frames in flight in the stream scheduler).
+ * Gaps in a worker's track are bubbles; a growing queue next to them shows
+ * which stage holds the others up.
+ *
+ * Events are written as they happen under one lock, so tracing costs a
+ * little per frame; when no trace is open every call returns at once.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+int trace_open(const char *path);
+//Finish the file; threads must not trace any more. Does nothing if no trace is open.
+void trace_close(void);
+
+int trace_enabled(void);
+
+//Start of a span, in microseconds
+int64_t trace_now(void);
+
+//Span of stage name from start to now on the calling thread's track, for
+//frame of job (its manifest line). Either is left out if <0.
+void trace_span(const char *name,int64_t start,int job,int64_t frame);
+
+//Sample of a counter track
+void trace_counter(const char *name,int64_t value);
+
+//Name the calling thread's track: "name" or "name idx" if idx>=0
+void trace_thread_name(const char *name,int idx);
+
+#endif
@@ -0,0 +1,160 @@
+/**
+ * Verify mode: check conversions of generated patterns against checksums
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __STDC_CONSTANT_MACROS
+
+#ifdef _WIN32
+//Windows
+extern "C"
+{
+#include "libavutil/pixdesc.h"
+};
+#else
+//Linux...
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+#include <libavutil/pixdesc.h>
+#ifdef __cplusplus
+};
+#endif
+#endif
+
+#include "verify.h"
+#include "batch.h"
+#include "scaler.h"
+#include "../simplest_pic_gen/pattern_manifest.h"
+
+//Conversions are recorded bit exact, "bicubic+bitexact" in the convert
+//line: the SIMD paths of libswscale (MMX, SSE2, AVX2...) round differently,
+//and a golden manifest recorded on one machine must verify on any other.
+#define BITEXACT_SUFFIX "+bitexact"
+#define BITEXACT_FLAGS (SWS_BITEXACT|SWS_ACCURATE_RND)
+
+//Flags of a convert line's scaler, <0 if unknown
+static int parse_scaler(const char *scaler)
+{
+	char name[sizeof(((PatternManifest *)0)->scaler)];
+	size_t len=strlen(scaler),suffix_len=strlen(BITEXACT_SUFFIX);
+	if(len>suffix_len&&strcmp(scaler+len-suffix_len,BITEXACT_SUFFIX)==0){
+		snprintf(name,sizeof(name),"%.*s",(int)(len-suffix_len),scaler);
+		int flags=parse_sws_flags(name);
+		return flags<0?-1:flags|BITEXACT_FLAGS;
+	}
+	return parse_sws_flags(scaler);
+}
+
+//Draw every frame of m, convert it if m has a conversion, and hash the
+//result into hashes (m->frames entries)
+static int hash_frames(const PatternManifest *m,FrameHash *hashes)
+{
+	bool convert=m->dst_pixfmt!=AV_PIX_FMT_NONE;
+	PatternSpec spec=m->spec;
+	Frame src,dst;
+	Scaler scaler;
+
+	if(src.alloc(m->width,m->height,m->pixfmt)<0){
+		printf("Could not allocate source image\n");
+		return -1;
+	}
+	if(convert){
+		int flags=parse_scaler(m->scaler);
+		if(flags<0){
+			printf("Unknown scaler: %s\n",m->scaler);
+			return -1;
+		}
+		if(dst.alloc(m->dst_width,m->dst_height,m->dst_pixfmt)<0){
+			printf("Could not allocate destination image\n");
+			return -1;
+		}
+		if(scaler.init(m->width,m->height,m->pixfmt,m->dst_width,m->dst_height,m->dst_pixfmt,flags)<0){
+			printf("Could not create context for %s -> %s\n",
+				av_get_pix_fmt_name(m->pixfmt),av_get_pix_fmt_name(m->dst_pixfmt));
+			return -1;
+		}
+	}
+	for(int i=0;i<m->frames;i++){
+		const Frame &out=convert?dst:src;
+		spec.frame=m->spec.frame+i;
+		if(pattern_fill(&spec,src.data(),src.linesize(),m->pixfmt,m->width,m->height)<0)
+			return -1;
+		if(convert&&scaler.scale(src,dst)<0)
+			return -1;
+		if(frame_hash_planes(out.data(),out.linesize(),out.pixfmt(),out.width(),out.height(),&hashes[i])<0){
+			printf("Could not hash %s frames\n",av_get_pix_fmt_name(out.pixfmt()));
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int golden_main(const char *in_manifest,const char *out_manifest,
+				int dst_w,int dst_h,const char *dst_pixfmt,const char *flags)
+{
+	PatternManifest m;
+	int ret=0;
+
+	if(manifest_read(&m,in_manifest)<0)
+		return -1;
+	m.dst_pixfmt=av_get_pix_fmt(dst_pixfmt);
+	m.dst_width=dst_w;
+	m.dst_height=dst_h;
+	if(m.dst_pixfmt==AV_PIX_FMT_NONE){
+		printf("Not Support Output Pixel Format: %s\n",dst_pixfmt);
+		manifest_free(&m);
+		return -1;
+	}
+	if(parse_sws_flags(flags)<0){
+		printf("Unknown scaler: %s\n",flags);
+		manifest_free(&m);
+		return -1;
+	}
+	snprintf(m.scaler,sizeof(m.scaler),"%s" BITEXACT_SUFFIX,flags);
+	if(hash_frames(&m,m.hashes)<0||manifest_write(&m,out_manifest)<0){
+		printf("Could not record %s\n",out_manifest);
+		ret=-1;
+	}else{
+		printf("Recorded %d frames of %s %dx%d -> %s %dx%d %s in %s\n",m.frames,
+			av_get_pix_fmt_name(m.pixfmt),m.width,m.height,dst_pixfmt,dst_w,dst_h,flags,out_manifest);
+	}
+	manifest_free(&m);
+	return ret;
+}
+
+int verify_main(const char *manifest)
+{
+	PatternManifest m;
+	FrameHash *hashes;
+	int mismatches=0;
+
+	if(manifest_read(&m,manifest)<0)
+		return -1;
+	if(m.dst_pixfmt!=AV_PIX_FMT_NONE&&!strstr(m.scaler,BITEXACT_SUFFIX))
+		printf("%s was recorded without " BITEXACT_SUFFIX ", it only verifies on a machine with the same CPU features\n",
+			manifest);
+	hashes=(FrameHash *)malloc(m.frames*sizeof(FrameHash));
+	if(!hashes||hash_frames(&m,hashes)<0){
+		free(hashes);
+		manifest_free(&m);
+		return -1;
+	}
+	for(int i=0;i<m.frames;i++){
+		char got[FRAME_HASH_STRLEN],expected[FRAME_HASH_STRLEN];
+		if(frame_hash_equal(&hashes[i],&m.hashes[i]))
+			continue;
+		frame_hash_string(&hashes[i],got);
+		frame_hash_string(&m.hashes[i],expected);
+		printf("Frame %5d: %s, expected %s\n",i,got,expected);
+		mismatches++;
+	}
+	printf("Verify %s: %d of %d frames match\n",manifest,m.frames-mismatches,m.frames);
+	free(hashes);
+	manifest_free(&m);
+	return mismatches?1:0;
+}
@@ -0,0 +1,24 @@
+/**
+ * Verify mode: check conversions of generated patterns against checksums
+ *
+ * The source frames are drawn in memory from a manifest written by
+ * simplest_pic_gen (see ../simplest_pic_gen/pattern_manifest.h), so no test
+ * media is needed on disk. -golden converts them once and records the
+ * hashes of the output in a new manifest, -verify does the same conversion
+ * again and compares every frame against it. Conversions are made with
+ * SWS_BITEXACT|SWS_ACCURATE_RND, recorded as e.g. "bicubic+bitexact", so
+ * the result does not depend on the SIMD code libswscale picks for the CPU.
+ */
+
+#ifndef VERIFY_H
+#define VERIFY_H
+
+//Record out_manifest: the pattern of in_manifest converted to dst_w x dst_h
+//dst_pixfmt with flags (see parse_sws_flags())
+int golden_main(const char *in_manifest,const char *out_manifest,
+				int dst_w,int dst_h,const char *dst_pixfmt,const char *flags);
+
+//0 if every frame matches, 1 if some do not, <0 on error
+int verify_main(const char *manifest);
+
+#endif
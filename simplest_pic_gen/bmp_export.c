@@ -0,0 +1,288 @@
+/**
+ * RGB24 / BGR24 to BMP
+ *
+ * The R/B swap is fused with the row copy. With SSSE3 it is one byte
+ * shuffle per 5 pixels; the kernel is compiled for SSSE3 on its own and
+ * chosen at run time.
+ */
+
+#ifndef _WIN32
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bmp_export.h"
+#include "pic_thread.h"
+
+#if defined(__GNUC__)&&(defined(__x86_64__)||defined(__i386__))
+#define BMP_SSSE3 1
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#include <tmmintrin.h>
+static int cpu_has_ssse3(void)
+{
+	return __builtin_cpu_supports("ssse3");
+}
+#elif defined(_MSC_VER)&&(defined(_M_X64)||defined(_M_IX86))
+#define BMP_SSSE3 1
+#define TARGET_SSSE3
+#include <intrin.h>
+#include <tmmintrin.h>
+static int cpu_has_ssse3(void)
+{
+	int info[4];
+	__cpuid(info,1);
+	return (info[2]>>9)&1;
+}
+#endif
+
+static void put_le16(unsigned char *p,unsigned int v)
+{
+	p[0]=v&0xFF;
+	p[1]=(v>>8)&0xFF;
+}
+
+static void put_le32(unsigned char *p,unsigned int v)
+{
+	p[0]=v&0xFF;
+	p[1]=(v>>8)&0xFF;
+	p[2]=(v>>16)&0xFF;
+	p[3]=(v>>24)&0xFF;
+}
+
+int bmp_row_size(int width)
+{
+	return (width*3+3)&~3;
+}
+
+void bmp_write_header(unsigned char header[BMP_HEADER_SIZE],int width,int height)
+{
+	unsigned int image_size=bmp_row_size(width)*height;
+
+	memset(header,0,BMP_HEADER_SIZE);
+	//BITMAPFILEHEADER
+	header[0]='B';
+	header[1]='M';
+	put_le32(header+2,BMP_HEADER_SIZE+image_size);   //File size
+	put_le32(header+10,BMP_HEADER_SIZE);             //Offset of the pixel data
+	//BITMAPINFOHEADER
+	put_le32(header+14,40);                          //Header size
+	put_le32(header+18,width);
+	//BMP storage pixel data in opposite direction of Y-axis (from bottom to top).
+	//A negative height stores it from top to bottom.
+	put_le32(header+22,(unsigned int)-height);
+	put_le16(header+26,1);                           //Color planes
+	put_le16(header+28,24);                          //Bits per pixel
+	put_le32(header+34,image_size);
+}
+
+static void convert_row_c(const unsigned char *src,unsigned char *dst,int x,int width)
+{
+	for(;x<width;x++){
+		dst[3*x]=src[3*x+2];
+		dst[3*x+1]=src[3*x+1];
+		dst[3*x+2]=src[3*x];
+	}
+}
+
+#ifdef BMP_SSSE3
+TARGET_SSSE3 static void convert_row_ssse3(const unsigned char *src,unsigned char *dst,int width)
+{
+	//Swap R and B of 5 pixels, byte 15 (next pixel's R) is rewritten by the next step
+	const __m128i shuf=_mm_setr_epi8(2,1,0,5,4,3,8,7,6,11,10,9,14,13,12,15);
+	int x=0;
+	for(;3*x+16<=3*width;x+=5){
+		__m128i v=_mm_loadu_si128((const __m128i *)(src+3*x));
+		_mm_storeu_si128((__m128i *)(dst+3*x),_mm_shuffle_epi8(v,shuf));
+	}
+	convert_row_c(src,dst,x,width);
+}
+#endif
+
+void bmp_convert_row(const unsigned char *src,unsigned char *dst,int width,int bgr)
+{
+	if(bgr){
+		//BMP order already
+		memcpy(dst,src,width*3);
+	}else{
+#ifdef BMP_SSSE3
+		if(cpu_has_ssse3())
+			convert_row_ssse3(src,dst,width);
+		else
+#endif
+			convert_row_c(src,dst,0,width);
+	}
+	memset(dst+width*3,0,bmp_row_size(width)-width*3);
+}
+
+static int seek64(FILE *fp,long long offset,int whence)
+{
+#ifdef _WIN32
+	return _fseeki64(fp,offset,whence);
+#else
+	return fseeko(fp,(off_t)offset,whence);
+#endif
+}
+
+static long long tell64(FILE *fp)
+{
+#ifdef _WIN32
+	return _ftelli64(fp);
+#else
+	return (long long)ftello(fp);
+#endif
+}
+
+typedef struct BmpWorker{
+	FILE *fp;
+	unsigned char *frame;       //One raw frame
+	unsigned char *bmp;         //Header and padded rows
+	int failed;
+}BmpWorker;
+
+typedef struct BmpJob{
+	const char *rawpath;
+	const char *bmp_pattern;
+	int width,height,bgr;
+	BmpWorker *workers;
+}BmpJob;
+
+/**
+ * Check an output pattern before it is handed to printf: exactly one
+ * integer conversion ("%d", "%5d", "%05d"), "%%" for a literal percent
+ * sign, nothing else.
+ */
+static int check_bmp_pattern(const char *pattern)
+{
+	const char *p=pattern;
+	int conversions=0;
+	while((p=strchr(p,'%'))!=NULL){
+		p++;
+		if(*p=='%'){
+			p++;
+			continue;
+		}
+		if(*p=='0')
+			p++;
+		//Width up to 2 digits, so a file name stays within 1024 bytes
+		if(*p>='1'&&*p<='9')
+			p++;
+		if(*p>='0'&&*p<='9')
+			p++;
+		if(*p!='d')
+			return -1;
+		p++;
+		conversions++;
+	}
+	return conversions==1?0:-1;
+}
+
+static void export_frame(void *arg,int item,int worker)
+{
+	BmpJob *job=(BmpJob *)arg;
+	BmpWorker *w=&job->workers[worker];
+	int frame_size=job->width*job->height*3;
+	int row_size=bmp_row_size(job->width);
+	int bmp_size=BMP_HEADER_SIZE+row_size*job->height;
+	char filename[1024];
+	FILE *fp_bmp;
+	int j=0;
+
+	//The export fails anyway; do not allocate again for every later item
+	if(w->failed)
+		return;
+	//Every thread reads through its own handle
+	if(!w->fp){
+		w->fp=fopen(job->rawpath,"rb");
+		w->frame=(unsigned char *)malloc(frame_size);
+		w->bmp=(unsigned char *)malloc(bmp_size);
+		if(w->bmp)
+			bmp_write_header(w->bmp,job->width,job->height);
+	}
+	if(!w->fp||!w->frame||!w->bmp){
+		w->failed=1;
+		return;
+	}
+	if(seek64(w->fp,(long long)item*frame_size,SEEK_SET)!=0||
+		fread(w->frame,1,frame_size,w->fp)!=(size_t)frame_size){
+		printf("Error: Cannot read frame %d.\n",item);
+		w->failed=1;
+		return;
+	}
+	for(j=0;j<job->height;j++)
+		bmp_convert_row(w->frame+j*job->width*3,w->bmp+BMP_HEADER_SIZE+j*row_size,job->width,job->bgr);
+
+	//One %d of at most 2 digits width (check_bmp_pattern()) in at most 900
+	//characters: fits
+	sprintf(filename,job->bmp_pattern,item);
+	if((fp_bmp=fopen(filename,"wb"))==NULL){
+		printf("Error: Cannot open output BMP file %s.\n",filename);
+		w->failed=1;
+		return;
+	}
+	if(fwrite(w->bmp,1,bmp_size,fp_bmp)!=(size_t)bmp_size)
+		w->failed=1;
+	if(fclose(fp_bmp)!=0)
+		w->failed=1;
+}
+
+int raw_to_bmp_sequence(const char *rawpath,const char *bmp_pattern,int width,int height,
+	int bgr,int nb_threads)
+{
+	BmpJob job;
+	FILE *fp=NULL;
+	long long file_size;
+	int frame_num=0,i=0,failed=0;
+
+	if(width<=0||height<=0){
+		printf("Error: Width, Height cannot be 0 or negative number!\n");
+		return -1;
+	}
+	if(strlen(bmp_pattern)>900){
+		printf("Error: Output pattern too long.\n");
+		return -1;
+	}
+	if(check_bmp_pattern(bmp_pattern)<0){
+		printf("Error: Output pattern %s must hold one %%d for the frame number.\n",bmp_pattern);
+		return -1;
+	}
+	if((fp=fopen(rawpath,"rb"))==NULL){
+		printf("Error: Cannot open input file %s.\n",rawpath);
+		return -1;
+	}
+	seek64(fp,0,SEEK_END);
+	file_size=tell64(fp);
+	fclose(fp);
+	frame_num=(int)(file_size/((long long)width*height*3));
+	if(frame_num<=0){
+		printf("Error: %s holds no complete frame.\n",rawpath);
+		return -1;
+	}
+
+	if(nb_threads<=0)
+		nb_threads=cpu_count();
+	job.rawpath=rawpath;
+	job.bmp_pattern=bmp_pattern;
+	job.width=width;
+	job.height=height;
+	job.bgr=bgr;
+	job.workers=(BmpWorker *)calloc(nb_threads,sizeof(BmpWorker));
+	if(!job.workers)
+		return -1;
+	if(parallel_for(frame_num,nb_threads,export_frame,&job)<0)
+		failed=1;
+	for(i=0;i<nb_threads;i++){
+		failed|=job.workers[i].failed;
+		if(job.workers[i].fp)
+			fclose(job.workers[i].fp);
+		free(job.workers[i].frame);
+		free(job.workers[i].bmp);
+	}
+	free(job.workers);
+	if(failed)
+		return -1;
+	printf("Finish generate %d BMP files from %s!\n",frame_num,rawpath);
+	return frame_num;
+}
@@ -0,0 +1,46 @@
+/**
+ * RGB24 / BGR24 to BMP
+ *
+ * Headers are serialized field by field in little endian, so they are the
+ * same 54 bytes whatever the size of long on the platform. Rows are padded
+ * to a multiple of 4 bytes as BMP requires.
+ */
+
+#ifndef BMP_EXPORT_H
+#define BMP_EXPORT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BMP_HEADER_SIZE 54
+
+//Bytes per BMP row of a 24-bit picture, padding included
+int bmp_row_size(int width);
+
+//File header and info header of a 24-bit, top-down picture
+void bmp_write_header(unsigned char header[BMP_HEADER_SIZE],int width,int height);
+
+//One row of RGB24 (bgr=0) or BGR24 (bgr=1) pixels to BMP's B|G|R order,
+//padding bytes zeroed. dst holds bmp_row_size(width) bytes.
+void bmp_convert_row(const unsigned char *src,unsigned char *dst,int width,int bgr);
+
+/**
+ * Convert every frame of a raw RGB24/BGR24 file to numbered BMPs in parallel
+ *
+ * @param rawpath		path of input file.
+ * @param bmp_pattern	output file names, with one %d for the frame number, e.g. "frame_%05d.bmp".
+ * @param width			the width of picture.
+ * @param height		the height of picture.
+ * @param bgr			1 if the input is BGR24.
+ * @param nb_threads	number of threads, <=0 for one per CPU core.
+ * @return number of frames written, -1 if there are errors.
+ */
+int raw_to_bmp_sequence(const char *rawpath,const char *bmp_pattern,int width,int height,
+	int bgr,int nb_threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,7 +1,7 @@
 ::include
-::@set INCLUDE=include;%INCLUDE%;
+@set INCLUDE=..\simplest_ffmpeg_swscale\include;%INCLUDE%;
 ::lib
-::@set LIB=lib;%LIB%;
+@set LIB=..\simplest_ffmpeg_swscale\lib;%LIB%;
 ::compile and link
-cl simplest_pic_gen.c
+cl simplest_pic_gen.c pic_thread.c bmp_export.c pattern.c pattern_writer.c pattern_manifest.c pic_fill.c /link avutil.lib
 exit
\ No newline at end of file
@@ -1,2 +1,3 @@
 #! /bin/sh
-g++ simplest_pic_gen.c -g -o simplest_pic_gen.out
+g++ simplest_pic_gen.c pic_thread.c bmp_export.c pattern.c pattern_writer.c pattern_manifest.c pic_fill.c -pthread -g -o simplest_pic_gen.out \
+-I /usr/local/include -L /usr/local/lib -lavutil
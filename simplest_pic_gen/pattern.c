@@ -0,0 +1,756 @@
+/**
+ * Test patterns drawn directly in any pixel format
+ *
+ * A picture is drawn one distinct row at a time: the row is worked out as
+ * component values (R,G,B or Y,U,V, then alpha) at the depth of each
+ * component, one color per bar rather than per pixel, and stored with
+ * av_write_image_line(), which knows the layout of every described format
+ * (8-bit components and components with a 16-bit word of their own, such
+ * as yuv420p10le or rgb48be, are stored directly).
+ * The first row is copied all the way down, then only the components that
+ * change from row to row are drawn again.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "pattern.h"
+
+#if defined(_MSC_VER)&&!defined(__cplusplus)
+//lfg.h uses inline, which MSVC only knows as __inline in C
+#define inline __inline
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#ifdef _WIN32
+//Windows
+#include "libavutil/pixdesc.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/lfg.h"
+#else
+//Linux...
+#include <libavutil/pixdesc.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/intreadwrite.h>
+#include <libavutil/lfg.h>
+#endif
+#ifdef __cplusplus
+}
+#endif
+
+//BT.601
+#define KR 0.299
+#define KG 0.587
+#define KB 0.114
+
+#define PATTERN_PI 3.14159265358979323846
+
+//Zone plate sine table
+#define SINE_BITS 10
+
+//Text glyphs: GLYPH_W x GLYPH_H dots in a CELL_W x CELL_H cell, scaled up
+//with the picture
+#define GLYPH_NUM 64
+#define GLYPH_W 5
+#define GLYPH_H 7
+#define CELL_W 6
+#define CELL_H 10
+
+//How the components of a format are laid out and what they mean
+typedef struct PatternLayout{
+	const AVPixFmtDescriptor *desc;
+	int width,height;
+	int nb_comp;
+	int rgb;                    //components are R,G,B
+	int full_range;             //yuvj*
+	int alpha;                  //index of the alpha component, -1 if none
+	int invert;                 //monowhite: 0 is white
+	int maxval[4];
+	int comp_w[4];              //samples per row of each component
+	int row_bytes[4];           //bytes per row of each plane, no padding
+	int plane_h[4];
+	int direct[4];              //stored without av_write_image_line()
+}PatternLayout;
+
+//Per frame state of the moving patterns. Most of them draw palette indices.
+typedef struct PatternState{
+	const PatternSpec *spec;
+	uint16_t palette[256][4];   //colors in the format
+	uint8_t *index;             //one row of palette indices
+	AVLFG lfg;
+	uint8_t sine[1<<SINE_BITS]; //PATTERN_ZONEPLATE, one turn
+	uint32_t zone_k;            //turns per squared pixel, 0.32 fixed point
+	uint32_t zone_t;            //phase at the frame
+	double cos_a,sin_a;         //PATTERN_MOVINGBARS
+	int rows_differ;
+	uint8_t glyphs[GLYPH_NUM][GLYPH_H];     //PATTERN_TEXT, GLYPH_W bits per row
+	int text_scale;
+}PatternState;
+
+static const unsigned char colorbar_rgb[8][3]={
+	{255,255,255},{255,255,0},{0,255,255},{0,255,0},
+	{255,0,255},{255,0,0},{0,0,255},{0,0,0}
+};
+
+static int chroma_size(int size,int shift)
+{
+	return -((-size)>>shift);
+}
+
+int pattern_check_pixfmt(enum AVPixelFormat pixfmt)
+{
+	const AVPixFmtDescriptor *desc=av_pix_fmt_desc_get(pixfmt);
+	if(!desc||desc->nb_components==0)
+		return -1;
+	if(desc->flags&(AV_PIX_FMT_FLAG_PAL|AV_PIX_FMT_FLAG_HWACCEL))
+		return -1;
+	if(strncmp(desc->name,"bayer_",6)==0)
+		return -1;
+	return 0;
+}
+
+static int get_layout(PatternLayout *l,enum AVPixelFormat pixfmt,int width,int height)
+{
+	const AVPixFmtDescriptor *desc=av_pix_fmt_desc_get(pixfmt);
+	int c=0,p=0;
+
+	if(width<=0||height<=0||pattern_check_pixfmt(pixfmt)<0)
+		return -1;
+	memset(l,0,sizeof(*l));
+	l->desc=desc;
+	l->width=width;
+	l->height=height;
+	l->nb_comp=desc->nb_components;
+	l->rgb=(desc->flags&AV_PIX_FMT_FLAG_RGB)!=0;
+	l->full_range=strncmp(desc->name,"yuvj",4)==0;
+	l->alpha=(desc->flags&AV_PIX_FMT_FLAG_ALPHA)?l->nb_comp-1:-1;
+	l->invert=pixfmt==AV_PIX_FMT_MONOWHITE;
+	for(c=0;c<l->nb_comp;c++){
+		l->maxval[c]=(1<<(desc->comp[c].depth_minus1+1))-1;
+		l->comp_w[c]=(c==1||c==2)?chroma_size(width,desc->log2_chroma_w):width;
+	}
+	if(av_image_fill_linesizes(l->row_bytes,pixfmt,width)<0)
+		return -1;
+	//Some descriptors only approximate the layout (uyyvyy411), make sure
+	//the last sample of each component lands inside its row
+	for(c=0;c<l->nb_comp;c++){
+		const AVComponentDescriptor *comp=&desc->comp[c];
+		int depth=comp->depth_minus1+1;
+		int64_t last=comp->offset_plus1-1+(int64_t)(l->comp_w[c]-1)*(comp->step_minus1+1);
+		int64_t end=(desc->flags&AV_PIX_FMT_FLAG_BITSTREAM)?(last+depth+7)>>3:
+			last+(comp->shift+depth>8?2:1);
+		if(end>l->row_bytes[comp->plane])
+			return -1;
+	}
+	for(p=0;p<4;p++)
+		l->plane_h[p]=(p==1||p==2)?chroma_size(height,desc->log2_chroma_h):height;
+	//8-bit components on byte boundaries, most formats, and components that
+	//have a 16-bit word to themselves (not shared like in packed 10-bit RGB)
+	for(c=0;c<l->nb_comp&&!(desc->flags&AV_PIX_FMT_FLAG_BITSTREAM);c++){
+		const AVComponentDescriptor *comp=&desc->comp[c];
+		int depth=comp->depth_minus1+1;
+		if(depth==8&&comp->shift==0){
+			l->direct[c]=1;
+		}else if(depth>8&&comp->shift+depth<=16){
+			l->direct[c]=1;
+			for(p=0;p<l->nb_comp;p++){
+				const AVComponentDescriptor *other=&desc->comp[p];
+				if(p!=c&&other->plane==comp->plane&&abs(other->offset_plus1-comp->offset_plus1)<2)
+					l->direct[c]=0;
+			}
+		}
+	}
+	return 0;
+}
+
+//BT.601 limited range Y,U,V to R,G,B, left unclamped so that converting
+//back gives the same values
+static void yuv_to_rgb(const double yuv[3],double rgb[3])
+{
+	double y=(yuv[0]-16)*255.0/219.0;
+	double u=(yuv[1]-128)*255.0/224.0;
+	double v=(yuv[2]-128)*255.0/224.0;
+	rgb[0]=y+2*(1-KR)*v;
+	rgb[2]=y+2*(1-KB)*u;
+	rgb[1]=(y-KR*rgb[0]-KB*rgb[2])/KG;
+}
+
+static int to_code(double v,int maxval)
+{
+	int code=(int)floor(v+0.5);
+	return code<0?0:(code>maxval?maxval:code);
+}
+
+//One color (R,G,B in 0-255, maybe out of range) as component values of the format
+static void native_color(const PatternLayout *l,const double rgb[3],uint16_t out[4])
+{
+	double val[3];
+	int c=0;
+
+	if(l->rgb){
+		val[0]=rgb[0];
+		val[1]=rgb[1];
+		val[2]=rgb[2];
+	}else{
+		double y=KR*rgb[0]+KG*rgb[1]+KB*rgb[2];
+		double u=(rgb[2]-y)/(2*(1-KB));
+		double v=(rgb[0]-y)/(2*(1-KR));
+		if(l->full_range){
+			val[0]=y;
+			val[1]=128+u;
+			val[2]=128+v;
+		}else{
+			val[0]=16+y*219.0/255.0;
+			val[1]=128+u*224.0/255.0;
+			val[2]=128+v*224.0/255.0;
+		}
+	}
+	for(c=0;c<l->nb_comp;c++){
+		if(c==l->alpha){
+			out[c]=l->maxval[c];
+		}else if(!l->rgb&&!l->full_range&&l->maxval[c]>=255){
+			//Limited range code values scale by powers of 2: 235 is 940 in 10 bits
+			out[c]=to_code(val[c]*((l->maxval[c]+1)>>8),l->maxval[c]);
+		}else{
+			out[c]=to_code(val[c]*l->maxval[c]/255.0,l->maxval[c]);
+		}
+	}
+	if(l->invert)
+		out[0]=l->maxval[0]-out[0];
+}
+
+//A color of the spec as R,G,B in 0-255. Y,U,V code values scale down by
+//powers of 2, R,G,B ones by full scale, the way native_color() scales up.
+static void spec_rgb(const PatternSpec *spec,const uint16_t color[3],double rgb[3])
+{
+	int bits=spec->color_bits>8?spec->color_bits:8;
+	double yuv[3];
+	int c=0;
+	for(c=0;c<3;c++){
+		if(spec->yuv)
+			yuv[c]=(double)color[c]/(1<<(bits-8));
+		else
+			rgb[c]=color[c]*255.0/((1<<bits)-1);
+	}
+	if(spec->yuv)
+		yuv_to_rgb(yuv,rgb);
+}
+
+static void spec_color(const PatternLayout *l,const PatternSpec *spec,const uint16_t color[3],uint16_t out[4])
+{
+	double rgb[3];
+	spec_rgb(spec,color,rgb);
+	native_color(l,rgb,out);
+}
+
+//Set columns [x0,x1) of a row (in luma columns) to one color
+static void fill_span(const PatternLayout *l,uint16_t *line[4],int x0,int x1,const uint16_t color[4])
+{
+	int c=0,x=0;
+	for(c=0;c<l->nb_comp;c++){
+		int s=(c==1||c==2)?l->desc->log2_chroma_w:0;
+		int end=chroma_size(x1,s);
+		for(x=chroma_size(x0,s);x<end;x++)
+			line[c][x]=color[c];
+	}
+}
+
+//1 if component c changes from row to row
+static int comp_varies(const PatternLayout *l,const PatternState *st,int c)
+{
+	if(c==l->alpha)
+		return 0;
+	switch(st->spec->type){
+	case PATTERN_ALLCOLOR:
+		//The one that follows Y
+		return (l->rgb?c:(c==0?2:c-1))==1;
+	case PATTERN_MOVINGBARS:
+		return st->rows_differ;
+	case PATTERN_ZONEPLATE:
+	case PATTERN_TEXT:
+	case PATTERN_NOISE:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static void set_palette(const PatternLayout *l,PatternState *st,int idx,double r,double g,double b)
+{
+	double rgb[3];
+	rgb[0]=r;
+	rgb[1]=g;
+	rgb[2]=b;
+	native_color(l,rgb,st->palette[idx]);
+}
+
+static uint32_t hash32(uint32_t a,uint32_t b,uint32_t c)
+{
+	uint32_t h=a^(b*0x9E3779B1u)^(c*0x85EBCA77u);
+	h^=h>>16;
+	h*=0x7FEB352Du;
+	h^=h>>15;
+	h*=0x846CA68Bu;
+	h^=h>>16;
+	return h;
+}
+
+static int64_t floor_div(int64_t a,int64_t b)
+{
+	return a>=0?a/b:-((-a+b-1)/b);
+}
+
+//Glyph in a cell of the text, 0 for blank. Lines have random lengths and
+//words are split by blanks.
+static int text_glyph(uint32_t seed,int64_t line,int cell)
+{
+	int len=8+hash32(seed,(uint32_t)line,0xFFFFFFFFu)%48;
+	uint32_t h=hash32(seed,(uint32_t)line,cell);
+	if(cell<2||cell>=2+len||(h>>8)%6==0)
+		return 0;
+	return 1+h%(GLYPH_NUM-1);
+}
+
+static int state_init(PatternState *st,const PatternLayout *l,const PatternSpec *spec)
+{
+	int i=0,j=0;
+
+	memset(st,0,sizeof(*st));
+	st->spec=spec;
+	switch(spec->type){
+	case PATTERN_ZONEPLATE:{
+		//Half a turn per pixel, Nyquist, where the circle meets the shorter edge
+		int d=l->width<l->height?l->width:l->height;
+		for(i=0;i<(1<<SINE_BITS);i++)
+			st->sine[i]=(uint8_t)floor(128+127*sin(2*PATTERN_PI*i/(1<<SINE_BITS)));
+		for(i=0;i<256;i++)
+			set_palette(l,st,i,i,i,i);
+		st->zone_k=(uint32_t)(4294967296.0/(2.0*d));
+		st->zone_t=((uint32_t)spec->frame*(uint32_t)spec->speed)<<26;
+		break;
+		}
+	case PATTERN_MOVINGBARS:{
+		int deg=(int)(((int64_t)spec->frame*spec->rotation%360+360)%360);
+		for(i=0;i<8;i++)
+			set_palette(l,st,i,colorbar_rgb[i][0],colorbar_rgb[i][1],colorbar_rgb[i][2]);
+		st->cos_a=cos(deg*PATTERN_PI/180);
+		st->sin_a=sin(deg*PATTERN_PI/180);
+		//Exact at right angles, so that upright bars have equal rows
+		if(deg%90==0){
+			st->cos_a=deg==0?1:(deg==180?-1:0);
+			st->sin_a=deg==90?1:(deg==270?-1:0);
+		}
+		st->rows_differ=st->sin_a!=0;
+		break;
+		}
+	case PATTERN_TEXT:
+		//Glyph 0 stays blank
+		av_lfg_init(&st->lfg,spec->seed);
+		for(i=1;i<GLYPH_NUM;i++){
+			for(j=0;j<GLYPH_H;j++)
+				st->glyphs[i][j]=av_lfg_get(&st->lfg)&((1<<GLYPH_W)-1);
+		}
+		set_palette(l,st,0,32,32,32);
+		set_palette(l,st,1,224,224,224);
+		st->text_scale=l->height/240>1?l->height/240:1;
+		break;
+	case PATTERN_NOISE:
+		//One sequence per frame, so frames can be drawn in any order
+		av_lfg_init(&st->lfg,spec->seed+(uint32_t)spec->frame*2654435761u);
+		break;
+	default:
+		return 0;
+	}
+	if(spec->type!=PATTERN_NOISE){
+		st->index=(uint8_t *)malloc(l->width);
+		if(!st->index)
+			return -1;
+	}
+	return 0;
+}
+
+//Palette colors of the indices of the row
+static void map_index(const PatternLayout *l,const PatternState *st,uint16_t *line[4],int mask)
+{
+	int c=0,x=0;
+	for(c=0;c<l->nb_comp;c++){
+		int s=(c==1||c==2)?l->desc->log2_chroma_w:0;
+		if(!(mask&(1<<c)))
+			continue;
+		for(x=0;x<l->comp_w[c];x++)
+			line[c][x]=st->palette[st->index[x<<s]][c];
+	}
+}
+
+//Work out the values of the components in mask for row y (luma rows). Only
+//components for which comp_varies() are asked for after the first row.
+static void render_row(const PatternLayout *l,PatternState *st,int y,uint16_t *line[4],int mask)
+{
+	const PatternSpec *spec=st->spec;
+	int width=l->comp_w[0];
+	uint16_t color[4],white[4];
+	int b=0,c=0,x=0;
+
+	switch(spec->type){
+	case PATTERN_BARS:{
+		int barnum=spec->barnum>0?spec->barnum:1;
+		for(b=0;b<barnum;b++){
+			double rgb0[3],rgb1[3],rgb[3];
+			double t=barnum>1?(double)b/(barnum-1):0;
+			spec_rgb(spec,spec->color0,rgb0);
+			spec_rgb(spec,spec->color1,rgb1);
+			for(c=0;c<3;c++)
+				rgb[c]=rgb0[c]+(rgb1[c]-rgb0[c])*t;
+			native_color(l,rgb,color);
+			fill_span(l,line,(int)((int64_t)b*width/barnum),(int)((int64_t)(b+1)*width/barnum),color);
+		}
+		break;
+		}
+	case PATTERN_COLORBAR:{
+		for(b=0;b<8;b++){
+			double rgb[3];
+			for(c=0;c<3;c++)
+				rgb[c]=colorbar_rgb[b][c];
+			native_color(l,rgb,color);
+			fill_span(l,line,(int)((int64_t)b*width/8),(int)((int64_t)(b+1)*width/8),color);
+		}
+		break;
+		}
+	case PATTERN_STRIPE:{
+		double white_rgb[3]={255,255,255};
+		native_color(l,white_rgb,white);
+		spec_color(l,spec,spec->color0,color);
+		for(c=0;c<l->nb_comp;c++){
+			int s=(c==1||c==2)?l->desc->log2_chroma_w:0;
+			//Subsampled components are taken from even columns, which are white
+			for(x=0;x<l->comp_w[c];x++)
+				line[c][x]=((x<<s)&1)?color[c]:white[c];
+		}
+		break;
+		}
+	case PATTERN_ALLCOLOR:{
+		//R,G,B = X,Y,frame; Y,U,V = frame,X,Y
+		int axis[3];
+		uint16_t scale[4][256];
+		int v=0;
+		for(c=0;c<l->nb_comp;c++){
+			int shift=(c==1||c==2)?l->desc->log2_chroma_w:0;
+			int depth=l->desc->comp[c].depth_minus1+1;
+			if(!(mask&(1<<c)))
+				continue;
+			for(v=0;v<256;v++)
+				scale[c][v]=depth>=8?v<<(depth-8):v>>(8-depth);
+			if(c==l->alpha){
+				for(x=0;x<l->comp_w[c];x++)
+					line[c][x]=l->maxval[c];
+				continue;
+			}
+			axis[0]=-1;
+			axis[1]=y;
+			axis[2]=spec->frame;
+			//Index in X,Y,frame of this component
+			b=l->rgb?c:(c==0?2:c-1);
+			if(b==0){
+				for(x=0;x<l->comp_w[c];x++)
+					line[c][x]=scale[c][(x<<shift)&255];
+			}else{
+				uint16_t val=scale[c][axis[b]&255];
+				for(x=0;x<l->comp_w[c];x++)
+					line[c][x]=val;
+			}
+		}
+		break;
+		}
+	case PATTERN_ZONEPLATE:{
+		//Phase follows x*x+y*y, updated by 2*x+1 per pixel; it wraps
+		//around at whole turns
+		int dx=-(l->width/2),dy=y-l->height/2;
+		uint32_t k=st->zone_k;
+		uint32_t phase=(uint32_t)(dx*dx+dy*dy)*k+st->zone_t;
+		for(x=0;x<width;x++,dx++){
+			st->index[x]=st->sine[phase>>(32-SINE_BITS)];
+			phase+=(uint32_t)(2*dx+1)*k;
+		}
+		map_index(l,st,line,mask);
+		break;
+		}
+	case PATTERN_MOVINGBARS:{
+		//Position across the bars, in 1/2^32 bar, rotating around the center
+		double bar_w=width/8.0;
+		double u=((0-l->width/2)*st->cos_a+(y-l->height/2)*st->sin_a)/bar_w+4+
+			(double)spec->frame*spec->speed/bar_w;
+		int64_t pos=(int64_t)floor(u*4294967296.0);
+		int64_t step=(int64_t)floor(st->cos_a/bar_w*4294967296.0+0.5);
+		for(x=0;x<width;x++,pos+=step)
+			st->index[x]=(uint8_t)((pos>>32)&7);
+		map_index(l,st,line,mask);
+		break;
+		}
+	case PATTERN_TEXT:{
+		//Scrolls up: row y shows text row y+frame*speed
+		int scale=st->text_scale;
+		int64_t ty=floor_div((int64_t)y+(int64_t)spec->frame*spec->speed,scale);
+		int64_t text_line=floor_div(ty,CELL_H);
+		int gy=(int)(ty-text_line*CELL_H);
+		int cell=0,u=0,k=0;
+		memset(st->index,0,width);
+		for(x=0;gy<GLYPH_H&&x<width;cell++){
+			int bits=st->glyphs[text_glyph(spec->seed,text_line,cell)][gy];
+			for(u=0;u<CELL_W&&x<width;u++){
+				int dot=u<GLYPH_W&&((bits>>(GLYPH_W-1-u))&1);
+				for(k=0;k<scale&&x<width;k++)
+					st->index[x++]=dot;
+			}
+		}
+		map_index(l,st,line,mask);
+		break;
+		}
+	case PATTERN_NOISE:{
+		for(c=0;c<l->nb_comp;c++){
+			int shift=32-(l->desc->comp[c].depth_minus1+1);
+			if(!(mask&(1<<c)))
+				continue;
+			if(c==l->alpha){
+				for(x=0;x<l->comp_w[c];x++)
+					line[c][x]=l->maxval[c];
+				continue;
+			}
+			for(x=0;x<l->comp_w[c];x++)
+				line[c][x]=av_lfg_get(&st->lfg)>>shift;
+		}
+		break;
+		}
+	case PATTERN_RAMP:{
+		//Code value x*(maxval+1)/width, counted up without dividing
+		for(c=0;c<l->nb_comp;c++){
+			int levels=l->maxval[c]+1;
+			int code=0,acc=0;
+			if(c==l->alpha||(!l->rgb&&(c==1||c==2))){
+				uint16_t val=c==l->alpha?l->maxval[c]:levels>>1;
+				for(x=0;x<l->comp_w[c];x++)
+					line[c][x]=val;
+				continue;
+			}
+			for(x=0;x<width;x++){
+				line[c][x]=code;
+				for(acc+=levels;acc>=width;acc-=width)
+					code++;
+			}
+		}
+		break;
+		}
+	}
+}
+
+//Store the values of component c in one row of its plane
+static void store_line(const PatternLayout *l,uint8_t *planes[4],const int linesize[4],
+	int c,int row,const uint16_t *line)
+{
+	const AVComponentDescriptor *comp=&l->desc->comp[c];
+	int step=comp->step_minus1+1;
+	int shift=comp->shift;
+	int x=0;
+
+	if(l->direct[c]){
+		uint8_t *p=planes[comp->plane]+row*linesize[comp->plane]+comp->offset_plus1-1;
+		if(comp->depth_minus1==7){
+			for(x=0;x<l->comp_w[c];x++)
+				p[x*step]=(uint8_t)line[x];
+		}else if(l->desc->flags&AV_PIX_FMT_FLAG_BE){
+			for(x=0;x<l->comp_w[c];x++)
+				AV_WB16(p+x*step,line[x]<<shift);
+		}else{
+			for(x=0;x<l->comp_w[c];x++)
+				AV_WL16(p+x*step,line[x]<<shift);
+		}
+		return;
+	}
+	av_write_image_line(line,planes,linesize,l->desc,0,row,c,l->comp_w[c]);
+}
+
+int pattern_fill(const PatternSpec *spec,uint8_t *const data[4],const int linesize[4],
+	enum AVPixelFormat pixfmt,int width,int height)
+{
+	PatternLayout l;
+	PatternState st;
+	uint16_t *line[4]={NULL};
+	uint8_t *planes[4];
+	int varies[4]={0},redraw[4]={0};
+	int mask=0;
+	int c=0,p=0,y=0,ret=0;
+
+	st.index=NULL;
+	if(get_layout(&l,pixfmt,width,height)<0){
+		printf("Error: Cannot draw patterns in %s %dx%d.\n",av_get_pix_fmt_name(pixfmt),width,height);
+		return -1;
+	}
+	for(c=0;c<l.nb_comp;c++){
+		line[c]=(uint16_t *)malloc(width*sizeof(uint16_t));
+		if(!line[c]){
+			ret=-1;
+			goto end;
+		}
+	}
+	if(state_init(&st,&l,spec)<0){
+		ret=-1;
+		goto end;
+	}
+	for(p=0;p<4;p++)
+		planes[p]=data[p];
+	for(c=0;c<l.nb_comp;c++){
+		varies[c]=comp_varies(&l,&st,c);
+		//av_write_image_line() ORs bits into place, such rows are drawn again whole
+		if(varies[c]&&!l.direct[c])
+			redraw[l.desc->comp[c].plane]=1;
+	}
+	for(c=0;c<l.nb_comp;c++){
+		if(varies[c]||redraw[l.desc->comp[c].plane])
+			mask|=1<<c;
+	}
+
+	//First row, copied all the way down
+	render_row(&l,&st,0,line,(1<<l.nb_comp)-1);
+	for(p=0;p<4;p++){
+		if(l.row_bytes[p]>0)
+			memset(planes[p],0,l.row_bytes[p]);
+	}
+	for(c=0;c<l.nb_comp;c++)
+		store_line(&l,planes,linesize,c,0,line[c]);
+	for(p=0;p<4;p++){
+		for(y=1;l.row_bytes[p]>0&&y<l.plane_h[p];y++)
+			memcpy(planes[p]+y*linesize[p],planes[p],l.row_bytes[p]);
+	}
+	//Then the components that change down the picture
+	for(y=1;mask&&y<height;y++){
+		int sub_row=y&((1<<l.desc->log2_chroma_h)-1);
+		render_row(&l,&st,y,line,mask);
+		for(p=0;p<4;p++){
+			if(redraw[p]&&!((p==1||p==2)&&sub_row))
+				memset(planes[p]+((p==1||p==2)?y>>l.desc->log2_chroma_h:y)*linesize[p],0,l.row_bytes[p]);
+		}
+		for(c=0;c<l.nb_comp;c++){
+			if(!(mask&(1<<c))||((c==1||c==2)&&sub_row))
+				continue;
+			store_line(&l,planes,linesize,c,(c==1||c==2)?y>>l.desc->log2_chroma_h:y,line[c]);
+		}
+	}
+
+end:
+	free(st.index);
+	for(c=0;c<4;c++)
+		free(line[c]);
+	return ret;
+}
+
+//Planes of a raw frame in one buffer
+static int raw_planes(uint8_t *buffer,uint8_t *data[4],int linesize[4],
+	enum AVPixelFormat pixfmt,int width,int height)
+{
+	PatternLayout l;
+	int size=0,p=0;
+
+	if(get_layout(&l,pixfmt,width,height)<0)
+		return -1;
+	for(p=0;p<4;p++){
+		linesize[p]=l.row_bytes[p];
+		data[p]=l.row_bytes[p]>0&&buffer?buffer+size:NULL;
+		size+=l.row_bytes[p]*l.plane_h[p];
+	}
+	return size;
+}
+
+int pattern_frame_size(enum AVPixelFormat pixfmt,int width,int height)
+{
+	uint8_t *data[4];
+	int linesize[4];
+	return raw_planes(NULL,data,linesize,pixfmt,width,height);
+}
+
+int pattern_fill_buffer(const PatternSpec *spec,uint8_t *buffer,
+	enum AVPixelFormat pixfmt,int width,int height)
+{
+	uint8_t *data[4];
+	int linesize[4];
+	if(raw_planes(buffer,data,linesize,pixfmt,width,height)<0)
+		return -1;
+	return pattern_fill(spec,data,linesize,pixfmt,width,height);
+}
+
+int pattern_is_still(const PatternSpec *spec)
+{
+	switch(spec->type){
+	case PATTERN_ALLCOLOR:
+	case PATTERN_NOISE:
+		return 0;
+	case PATTERN_ZONEPLATE:
+	case PATTERN_TEXT:
+		return spec->speed==0;
+	case PATTERN_MOVINGBARS:
+		return spec->speed==0&&spec->rotation%360==0;
+	default:
+		return 1;
+	}
+}
+
+int pattern_preset(PatternSpec *spec,const char *name)
+{
+	memset(spec,0,sizeof(*spec));
+	if(strcmp(name,"colorbar")==0){
+		spec->type=PATTERN_COLORBAR;
+	}else if(strcmp(name,"graybar")==0){
+		//Gray Bar, from 16 to 235
+		uint16_t c0[3]={16,128,128},c1[3]={235,128,128};
+		spec->type=PATTERN_BARS;
+		spec->barnum=10;
+		spec->yuv=1;
+		memcpy(spec->color0,c0,sizeof(c0));
+		memcpy(spec->color1,c1,sizeof(c1));
+	}else if(strcmp(name,"rgbgradient")==0){
+		//10 bars, RGB changed from 255,0,0 to 0,0,255
+		uint16_t c0[3]={255,0,0},c1[3]={0,0,255};
+		spec->type=PATTERN_BARS;
+		spec->barnum=10;
+		memcpy(spec->color0,c0,sizeof(c0));
+		memcpy(spec->color1,c1,sizeof(c1));
+	}else if(strcmp(name,"yuvgradient")==0){
+		//10 bars, YUV changed from 0,0,0 to 128,128,128
+		uint16_t c1[3]={128,128,128};
+		spec->type=PATTERN_BARS;
+		spec->barnum=10;
+		spec->yuv=1;
+		memcpy(spec->color1,c1,sizeof(c1));
+	}else if(strcmp(name,"stripe")==0){
+		//Red stripe
+		spec->type=PATTERN_STRIPE;
+		spec->color0[0]=255;
+	}else if(strcmp(name,"allcolor")==0){
+		spec->type=PATTERN_ALLCOLOR;
+	}else if(strcmp(name,"ramp")==0){
+		spec->type=PATTERN_RAMP;
+	}else if(strcmp(name,"zoneplate")==0){
+		//Rings moving in by 1/16 turn per frame
+		spec->type=PATTERN_ZONEPLATE;
+		spec->speed=4;
+	}else if(strcmp(name,"movingbars")==0){
+		spec->type=PATTERN_MOVINGBARS;
+		spec->speed=4;
+	}else if(strcmp(name,"rotatingbars")==0){
+		spec->type=PATTERN_MOVINGBARS;
+		spec->rotation=1;
+	}else if(strcmp(name,"scrolltext")==0){
+		spec->type=PATTERN_TEXT;
+		spec->speed=2;
+		spec->seed=1;
+	}else if(strcmp(name,"noise")==0){
+		spec->type=PATTERN_NOISE;
+		spec->seed=1;
+	}else{
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,99 @@
+/**
+ * Test patterns drawn directly in any pixel format
+ *
+ * Patterns are described by a PatternSpec and drawn into the planes of any
+ * format libavutil has a descriptor for (planar, packed, semi-planar,
+ * subsampled, bit packed...), except paletted, Bayer and hardware formats.
+ * RGB formats get the colors as they are, YUV formats get them converted
+ * with BT.601 (limited range, full range for yuvj*).
+ *
+ * Components are drawn at their own depth, 8 to 16 bits, either byte order.
+ * Limited range code values scale by powers of 2 (235 is 940 in 10 bits),
+ * full range ones by full scale (255 is 1023), so bars land on exact code
+ * values at any depth. Colors can also be given at more than 8 bits.
+ *
+ * Besides the bars of main(), there is moving content that is closer to
+ * what scalers see in practice: a zone plate, moving or rotating bars,
+ * scrolling text-like glyphs and noise. It only depends on the seed and
+ * the frame number, so sequences can be drawn again instead of stored.
+ */
+
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef _WIN32
+//Windows
+#include "libavutil/pixfmt.h"
+#else
+//Linux...
+#include <libavutil/pixfmt.h>
+#endif
+#include <stdint.h>
+
+typedef enum PatternType{
+	PATTERN_BARS=0,             //barnum vertical bars, color0 to color1 in even steps
+	PATTERN_COLORBAR,           //white, yellow, cyan, green, magenta, red, blue, black
+	PATTERN_STRIPE,             //1 pixel wide stripes, white and color0
+	PATTERN_ALLCOLOR,           //components follow X, Y and the frame number
+	PATTERN_ZONEPLATE,          //circular zone plate, up to Nyquist at the shorter edge
+	PATTERN_MOVINGBARS,         //color bars moving sideways and rotating
+	PATTERN_TEXT,               //lines of random glyphs scrolling up, like credits
+	PATTERN_NOISE,              //uniform noise in every component
+	PATTERN_RAMP                //every code value of Y (R,G,B) left to right, neutral U,V
+}PatternType;
+
+typedef struct PatternSpec{
+	PatternType type;
+	int barnum;
+	int yuv;                    //color0/color1 are Y,U,V (BT.601, 16-235) instead of R,G,B
+	uint16_t color0[3];
+	uint16_t color1[3];
+	int color_bits;             //depth of color0/color1, 8 if 0; Y 64-940 in 10 bits
+	int frame;                  //PATTERN_ALLCOLOR: third axis, 0-255; moving patterns: time
+	unsigned int seed;          //PATTERN_TEXT glyphs, PATTERN_NOISE
+	int speed;                  //pixels per frame; PATTERN_ZONEPLATE: 1/64 turn per frame
+	int rotation;               //PATTERN_MOVINGBARS: degrees per frame
+}PatternSpec;
+
+/**
+ * Fill spec with the parameters main() uses for one of the pictures:
+ * "colorbar", "graybar", "rgbgradient", "yuvgradient", "stripe", "allcolor",
+ * "ramp", or with defaults for a moving one: "zoneplate", "movingbars", "rotatingbars",
+ * "scrolltext", "noise".
+ *
+ * @return 0 if finished, -1 if the name is unknown.
+ */
+int pattern_preset(PatternSpec *spec,const char *name);
+
+//0 if patterns can be drawn in pixfmt, -1 otherwise
+int pattern_check_pixfmt(enum AVPixelFormat pixfmt);
+
+//Size of one frame in a raw file (planes back to back, rows not padded), -1 on error
+int pattern_frame_size(enum AVPixelFormat pixfmt,int width,int height);
+
+/**
+ * Draw a pattern into the planes of a picture
+ *
+ * Every distinct row is worked out once, the other rows are copies of it.
+ *
+ * @return 0 if finished, -1 if there are errors.
+ */
+int pattern_fill(const PatternSpec *spec,uint8_t *const data[4],const int linesize[4],
+	enum AVPixelFormat pixfmt,int width,int height);
+
+//The same, into one buffer of pattern_frame_size() bytes
+int pattern_fill_buffer(const PatternSpec *spec,uint8_t *buffer,
+	enum AVPixelFormat pixfmt,int width,int height);
+
+//1 if every frame of the pattern is the same
+int pattern_is_still(const PatternSpec *spec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
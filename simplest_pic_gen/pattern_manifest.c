@@ -0,0 +1,265 @@
+/**
+ * Checksum manifests of pattern sequences
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pattern_manifest.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#ifdef _WIN32
+//Windows
+#include "libavutil/pixdesc.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/md5.h"
+#include "libavutil/crc.h"
+#include "libavutil/mem.h"
+#else
+//Linux...
+#include <libavutil/pixdesc.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/md5.h>
+#include <libavutil/crc.h>
+#include <libavutil/mem.h>
+#endif
+#ifdef __cplusplus
+}
+#endif
+
+//In the order of PatternType
+static const char *const type_names[]={
+	"bars","colorbar","stripe","allcolor","zoneplate","movingbars","text","noise","ramp"
+};
+
+#define NB_TYPES ((int)(sizeof(type_names)/sizeof(type_names[0])))
+
+void manifest_init(PatternManifest *m)
+{
+	memset(m,0,sizeof(*m));
+	m->pixfmt=AV_PIX_FMT_NONE;
+	m->dst_pixfmt=AV_PIX_FMT_NONE;
+}
+
+void manifest_free(PatternManifest *m)
+{
+	free(m->hashes);
+	manifest_init(m);
+}
+
+int manifest_write(const PatternManifest *m,const char *path)
+{
+	const PatternSpec *s=&m->spec;
+	FILE *fp=fopen(path,"w");
+	char hash[FRAME_HASH_STRLEN];
+	int i=0,ret=0;
+
+	if(!fp||s->type<0||s->type>=NB_TYPES){
+		if(fp)
+			fclose(fp);
+		return -1;
+	}
+	fprintf(fp,"#simplest_pic_gen manifest\n");
+	fprintf(fp,"pattern type=%s barnum=%d yuv=%d color0=%d,%d,%d color1=%d,%d,%d color_bits=%d "
+		"frame=%d seed=%u speed=%d rotation=%d\n",type_names[s->type],s->barnum,s->yuv,
+		s->color0[0],s->color0[1],s->color0[2],s->color1[0],s->color1[1],s->color1[2],
+		s->color_bits,s->frame,s->seed,s->speed,s->rotation);
+	fprintf(fp,"source %s %d %d\n",av_get_pix_fmt_name(m->pixfmt),m->width,m->height);
+	if(m->dst_pixfmt!=AV_PIX_FMT_NONE)
+		fprintf(fp,"convert %s %d %d %s\n",av_get_pix_fmt_name(m->dst_pixfmt),
+			m->dst_width,m->dst_height,m->scaler);
+	fprintf(fp,"frames %d\n",m->frames);
+	for(i=0;i<m->frames;i++){
+		frame_hash_string(&m->hashes[i],hash);
+		fprintf(fp,"%d %s\n",i,hash);
+	}
+	if(ferror(fp))
+		ret=-1;
+	if(fclose(fp)!=0)
+		ret=-1;
+	return ret;
+}
+
+static int parse_color(const char *str,uint16_t color[3])
+{
+	unsigned int c0,c1,c2;
+	if(sscanf(str,"%u,%u,%u",&c0,&c1,&c2)!=3||c0>65535||c1>65535||c2>65535)
+		return -1;
+	color[0]=c0;
+	color[1]=c1;
+	color[2]=c2;
+	return 0;
+}
+
+//key=value pairs as written by manifest_write()
+static int parse_spec(PatternSpec *spec,const char *str)
+{
+	char key[32],val[64];
+	int n=0,i=0;
+
+	memset(spec,0,sizeof(*spec));
+	spec->type=(PatternType)-1;
+	while(sscanf(str," %31[^= \t\r\n]=%63s%n",key,val,&n)==2){
+		str+=n;
+		if(strcmp(key,"type")==0){
+			for(i=0;i<NB_TYPES&&strcmp(type_names[i],val)!=0;i++);
+			if(i==NB_TYPES)
+				return -1;
+			spec->type=(PatternType)i;
+		}else if(strcmp(key,"barnum")==0){
+			spec->barnum=atoi(val);
+		}else if(strcmp(key,"yuv")==0){
+			spec->yuv=atoi(val);
+		}else if(strcmp(key,"color0")==0){
+			if(parse_color(val,spec->color0)<0)
+				return -1;
+		}else if(strcmp(key,"color1")==0){
+			if(parse_color(val,spec->color1)<0)
+				return -1;
+		}else if(strcmp(key,"color_bits")==0){
+			spec->color_bits=atoi(val);
+		}else if(strcmp(key,"frame")==0){
+			spec->frame=atoi(val);
+		}else if(strcmp(key,"seed")==0){
+			spec->seed=(unsigned int)strtoul(val,NULL,0);
+		}else if(strcmp(key,"speed")==0){
+			spec->speed=atoi(val);
+		}else if(strcmp(key,"rotation")==0){
+			spec->rotation=atoi(val);
+		}else{
+			return -1;
+		}
+	}
+	if(spec->color_bits<0||spec->color_bits>16)
+		return -1;
+	return (int)spec->type<0?-1:0;
+}
+
+static int parse_md5(const char *hex,uint8_t md5[16])
+{
+	unsigned int v;
+	int i=0;
+	if(strlen(hex)!=32)
+		return -1;
+	for(i=0;i<16;i++){
+		if(sscanf(hex+2*i,"%2x",&v)!=1)
+			return -1;
+		md5[i]=v;
+	}
+	return 0;
+}
+
+int manifest_read(PatternManifest *m,const char *path)
+{
+	FILE *fp=fopen(path,"r");
+	char line[1024],word[32],fmt[64],md5[64];
+	int have_pattern=0,have_source=0,got=0,line_idx=0,n=0,idx=0;
+	unsigned int crc;
+
+	manifest_init(m);
+	if(!fp){
+		printf("Error: Cannot open manifest %s.\n",path);
+		return -1;
+	}
+	while(fgets(line,sizeof(line),fp)){
+		line_idx++;
+		if(line[0]=='#'||sscanf(line,"%31s%n",word,&n)!=1)
+			continue;
+		if(strcmp(word,"pattern")==0){
+			if(parse_spec(&m->spec,line+n)<0)
+				goto fail;
+			have_pattern=1;
+		}else if(strcmp(word,"source")==0){
+			if(sscanf(line+n,"%63s %d %d",fmt,&m->width,&m->height)!=3||
+				(m->pixfmt=av_get_pix_fmt(fmt))==AV_PIX_FMT_NONE)
+				goto fail;
+			have_source=1;
+		}else if(strcmp(word,"convert")==0){
+			if(sscanf(line+n,"%63s %d %d %31s",fmt,&m->dst_width,&m->dst_height,m->scaler)!=4||
+				(m->dst_pixfmt=av_get_pix_fmt(fmt))==AV_PIX_FMT_NONE)
+				goto fail;
+		}else if(strcmp(word,"frames")==0){
+			if(m->hashes||sscanf(line+n,"%d",&m->frames)!=1||m->frames<=0)
+				goto fail;
+			m->hashes=(FrameHash *)calloc(m->frames,sizeof(FrameHash));
+			if(!m->hashes)
+				goto fail;
+		}else{
+			//Frames in order, after the frame count
+			if(!m->hashes||got==m->frames||sscanf(line,"%d %63s %x",&idx,md5,&crc)!=3||
+				idx!=got||parse_md5(md5,m->hashes[got].md5)<0)
+				goto fail;
+			m->hashes[got++].crc=crc;
+		}
+	}
+	fclose(fp);
+	if(!have_pattern||!have_source||!m->hashes||got<m->frames){
+		printf("Error: Manifest %s is incomplete.\n",path);
+		manifest_free(m);
+		return -1;
+	}
+	return 0;
+
+fail:
+	printf("Error: Cannot read manifest %s line %d.\n",path,line_idx);
+	fclose(fp);
+	manifest_free(m);
+	return -1;
+}
+
+int frame_hash_buffer(const uint8_t *buffer,int size,FrameHash *hash)
+{
+	const AVCRC *crc_table=av_crc_get_table(AV_CRC_32_IEEE_LE);
+	if(!crc_table||size<0)
+		return -1;
+	av_md5_sum(hash->md5,buffer,size);
+	hash->crc=av_crc(crc_table,0xFFFFFFFFu,buffer,size)^0xFFFFFFFFu;
+	return 0;
+}
+
+int frame_hash_planes(uint8_t *const data[4],const int linesize[4],
+	enum AVPixelFormat pixfmt,int width,int height,FrameHash *hash)
+{
+	const AVPixFmtDescriptor *desc=av_pix_fmt_desc_get(pixfmt);
+	const AVCRC *crc_table=av_crc_get_table(AV_CRC_32_IEEE_LE);
+	struct AVMD5 *md5=NULL;
+	uint32_t crc=0xFFFFFFFFu;
+	int row_bytes[4];
+	int p=0,y=0;
+
+	if(!desc||!crc_table||(desc->flags&(AV_PIX_FMT_FLAG_PAL|AV_PIX_FMT_FLAG_HWACCEL))||
+		av_image_fill_linesizes(row_bytes,pixfmt,width)<0)
+		return -1;
+	md5=av_md5_alloc();
+	if(!md5)
+		return -1;
+	av_md5_init(md5);
+	for(p=0;p<4;p++){
+		int plane_h=(p==1||p==2)?-((-height)>>desc->log2_chroma_h):height;
+		for(y=0;row_bytes[p]>0&&y<plane_h;y++){
+			const uint8_t *row=data[p]+y*linesize[p];
+			av_md5_update(md5,row,row_bytes[p]);
+			crc=av_crc(crc_table,crc,row,row_bytes[p]);
+		}
+	}
+	av_md5_final(md5,hash->md5);
+	av_free(md5);
+	hash->crc=crc^0xFFFFFFFFu;
+	return 0;
+}
+
+int frame_hash_equal(const FrameHash *a,const FrameHash *b)
+{
+	return memcmp(a->md5,b->md5,16)==0&&a->crc==b->crc;
+}
+
+void frame_hash_string(const FrameHash *hash,char str[FRAME_HASH_STRLEN])
+{
+	int i=0;
+	for(i=0;i<16;i++)
+		sprintf(str+2*i,"%02x",hash->md5[i]);
+	sprintf(str+32," %08x",(unsigned int)hash->crc);
+}
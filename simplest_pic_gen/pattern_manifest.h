@@ -0,0 +1,72 @@
+/**
+ * Checksum manifests of pattern sequences
+ *
+ * A manifest has everything needed to draw a sequence again (the spec,
+ * format and size), optionally a conversion applied to every frame, and
+ * the MD5 and CRC-32 of each resulting frame as raw data (planes back to
+ * back, rows not padded). A text file, one item per line:
+ *
+ *   #simplest_pic_gen manifest
+ *   pattern type=bars barnum=10 yuv=1 color0=16,128,128 ...
+ *   source yuv420p10le 1280 720
+ *   convert rgb24 640 360 bicubic+bitexact
+ *   frames 2
+ *   0 <md5> <crc32>
+ *   1 <md5> <crc32>
+ *
+ * The generator writes one next to each file, without a convert line.
+ * The converter adds the conversion and checks it (-golden, -verify), so
+ * regression runs need no media on disk.
+ */
+
+#ifndef PATTERN_MANIFEST_H
+#define PATTERN_MANIFEST_H
+
+#include "pattern.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Characters of frame_hash_string(), with the terminating zero
+#define FRAME_HASH_STRLEN 42
+
+typedef struct FrameHash{
+	uint8_t md5[16];
+	uint32_t crc;               //CRC-32 (IEEE), the same as zlib crc32()
+}FrameHash;
+
+typedef struct PatternManifest{
+	PatternSpec spec;           //spec.frame is the first frame
+	enum AVPixelFormat pixfmt;
+	int width,height;
+	enum AVPixelFormat dst_pixfmt;  //AV_PIX_FMT_NONE: frames as drawn
+	int dst_width,dst_height;
+	char scaler[32];            //flags name, e.g. bicubic
+	int frames;
+	FrameHash *hashes;          //frames entries, malloc()ed
+}PatternManifest;
+
+//An empty manifest, no conversion
+void manifest_init(PatternManifest *m);
+void manifest_free(PatternManifest *m);
+
+//@return 0 if finished, -1 if there are errors.
+int manifest_write(const PatternManifest *m,const char *path);
+//Replaces the contents of m. @return 0 if finished, -1 if there are errors.
+int manifest_read(PatternManifest *m,const char *path);
+
+//Hash of one raw frame
+int frame_hash_buffer(const uint8_t *buffer,int size,FrameHash *hash);
+//Hash of planes, the same as of the raw frame they would be written as
+int frame_hash_planes(uint8_t *const data[4],const int linesize[4],
+	enum AVPixelFormat pixfmt,int width,int height,FrameHash *hash);
+int frame_hash_equal(const FrameHash *a,const FrameHash *b);
+//"<md5> <crc32>" in hex
+void frame_hash_string(const FrameHash *hash,char str[FRAME_HASH_STRLEN]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
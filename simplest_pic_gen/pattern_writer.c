@@ -0,0 +1,384 @@
+/**
+ * Pattern sequences written to raw files or to stdout
+ *
+ * On POSIX systems every thread pwrite()s to the same descriptor. Windows
+ * has no positioned write on CRT files, so each thread opens the output
+ * for itself and seeks.
+ *
+ * On Linux a still pattern is written only a few times, then the file is
+ * grown by copying what it already holds onto its end, doubling each time.
+ * The copies are reflinks where the file system can share blocks (btrfs,
+ * XFS), copy_file_range() otherwise, so no data goes through user space.
+ */
+
+#ifndef _WIN32
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#endif
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
+#endif
+
+#include "pattern_writer.h"
+#include "pattern_manifest.h"
+#include "pic_thread.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#ifdef _WIN32
+//Windows
+#include "libavutil/pixdesc.h"
+#else
+//Linux...
+#include <libavutil/pixdesc.h>
+#endif
+#ifdef __cplusplus
+}
+#endif
+
+//Cap on the per-thread frame buffers together, 8K frames are large
+#define WRITER_MAX_BUFFERS (512<<20)
+
+//Cap on the frames of a still pattern written before it is copied
+#define WRITER_MAX_SEED (64<<20)
+
+typedef struct WriterJob{
+	PatternSpec spec;
+	enum AVPixelFormat pixfmt;
+	int width,height;
+	int frame_size;
+	const uint8_t *still;       //the only frame of a still pattern
+	uint8_t **buffers;          //per thread, moving patterns
+	int *failed;                //per thread
+	FrameHash *hashes;          //per frame, NULL without a manifest
+	PicOrder *order;            //stdout only
+	int first;                  //frames already in the file, items start after them
+	const char *path;
+#ifdef _WIN32
+	FILE **files;               //per thread
+#else
+	int fd;
+#endif
+}WriterJob;
+
+static double now_seconds(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER freq,count;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (double)count.QuadPart/freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec+ts.tv_nsec/1e9;
+#endif
+}
+
+static int write_at(WriterJob *job,int worker,const uint8_t *buf,long long offset)
+{
+#ifdef _WIN32
+	FILE *fp=job->files[worker];
+	if(!fp&&(fp=job->files[worker]=fopen(job->path,"r+b"))==NULL)
+		return -1;
+	if(_fseeki64(fp,offset,SEEK_SET)!=0)
+		return -1;
+	return fwrite(buf,1,job->frame_size,fp)==(size_t)job->frame_size?0:-1;
+#else
+	size_t done=0;
+	while(done<(size_t)job->frame_size){
+		ssize_t n=pwrite(job->fd,buf+done,job->frame_size-done,(off_t)(offset+done));
+		if(n<0&&errno==EINTR)
+			continue;
+		if(n<=0)
+			return -1;
+		done+=n;
+	}
+	return 0;
+#endif
+}
+
+#ifdef __linux__
+//Copy len bytes at src of fd to dst of fd, as a reflink if *clone is set.
+//*clone is cleared if the file system cannot reflink.
+static int copy_range(int fd,long long src,long long len,long long dst,int *clone)
+{
+#ifdef FICLONERANGE
+	if(clone&&*clone){
+		struct file_clone_range range;
+		range.src_fd=fd;
+		range.src_offset=src;
+		range.src_length=len;
+		range.dest_offset=dst;
+		if(ioctl(fd,FICLONERANGE,&range)==0)
+			return 0;
+		*clone=0;
+	}
+#endif
+#ifdef __NR_copy_file_range
+	while(len>0){
+		long long n=syscall(__NR_copy_file_range,fd,&src,fd,&dst,(size_t)len,0);
+		if(n<0&&errno==EINTR)
+			continue;
+		if(n<=0)
+			return -1;
+		len-=n;
+	}
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+static long long gcd(long long a,long long b)
+{
+	while(b){
+		long long t=a%b;
+		a=b;
+		b=t;
+	}
+	return a;
+}
+
+//Write the first frames of a still pattern, then double the file until it
+//has all of them. Returns the number of frames in the file (the rest is
+//left to plain writes), -1 on a write error.
+static int replicate_still(WriterJob *job,int frames,int *reflinked)
+{
+	long long frame_size=job->frame_size,total=(long long)frames*job->frame_size;
+	long long blk=4096,done=0,len=0,head=0;
+	struct stat st;
+	int clone=1;
+	int i=0,seed=1;
+
+	//Reflinks need block aligned offsets: enough frames to end on a block
+	if(fstat(job->fd,&st)==0&&st.st_blksize>0)
+		blk=st.st_blksize;
+	seed=(int)(blk/gcd(frame_size,blk));
+	if(seed>frames||seed*frame_size>WRITER_MAX_SEED)
+		seed=1;
+	for(i=0;i<seed;i++){
+		if(write_at(job,0,job->still,i*frame_size)<0)
+			return -1;
+	}
+	//Every copy starts on a frame, so [0,len) goes to [done,done+len) as it is
+	*reflinked=0;
+	for(done=seed*frame_size;done<total;done+=len){
+		len=total-done<done?total-done:done;
+		head=clone&&done%blk==0?len-len%blk:0;
+		if(head>0&&copy_range(job->fd,0,head,done,&clone)<0)
+			break;
+		if(len>head&&copy_range(job->fd,head,len-head,done+head,NULL)<0)
+			break;
+		if(clone&&head>0)
+			*reflinked=1;
+	}
+	return (int)(done/frame_size);
+}
+#endif
+
+static void write_frame(void *arg,int item,int worker)
+{
+	WriterJob *job=(WriterJob *)arg;
+	const uint8_t *frame=job->still;
+
+	item+=job->first;
+	if(!frame&&!job->failed[worker]){
+		PatternSpec spec=job->spec;
+		uint8_t *buf=job->buffers[worker];
+		if(!buf)
+			buf=job->buffers[worker]=(uint8_t *)malloc(job->frame_size);
+		spec.frame=job->spec.frame+item;
+		if(!buf||pattern_fill_buffer(&spec,buf,job->pixfmt,job->width,job->height)<0)
+			job->failed[worker]=1;
+		else if(job->hashes&&frame_hash_buffer(buf,job->frame_size,&job->hashes[item])<0)
+			job->failed[worker]=1;
+		frame=buf;
+	}
+	if(job->order){
+		//Take the turn even after a failure, later frames wait for it
+		pic_order_wait(job->order,item);
+		if(!job->failed[worker]&&fwrite(frame,1,job->frame_size,stdout)!=(size_t)job->frame_size)
+			job->failed[worker]=1;
+		pic_order_done(job->order,item);
+	}else if(!job->failed[worker]){
+		if(write_at(job,worker,frame,(long long)item*job->frame_size)<0)
+			job->failed[worker]=1;
+	}
+}
+
+int pattern_write_sequence(const PatternSpec *spec,const char *path,
+	enum AVPixelFormat pixfmt,int width,int height,int frames,int nb_threads,const char *manifest)
+{
+	WriterJob job;
+	PatternManifest m;
+	int to_stdout=strcmp(path,"-")==0;
+	//Keep stdout for the frames
+	FILE *log=to_stdout?stderr:stdout;
+	uint8_t *still=NULL;
+	double start=now_seconds(),elapsed;
+	int i=0,ret=0;
+
+	memset(&job,0,sizeof(job));
+	job.spec=*spec;
+	job.pixfmt=pixfmt;
+	job.width=width;
+	job.height=height;
+	job.path=path;
+	job.frame_size=pattern_frame_size(pixfmt,width,height);
+	if(job.frame_size<0){
+		fprintf(log,"Error: Cannot draw patterns in %s %dx%d.\n",av_get_pix_fmt_name(pixfmt),width,height);
+		return -1;
+	}
+	if(frames<=0)
+		return 0;
+	if(nb_threads<=0)
+		nb_threads=cpu_count();
+	if(nb_threads>frames)
+		nb_threads=frames;
+
+	manifest_init(&m);
+	if(manifest){
+		m.hashes=(FrameHash *)malloc(frames*sizeof(FrameHash));
+		if(!m.hashes)
+			return -1;
+		job.hashes=m.hashes;
+	}
+	if(pattern_is_still(spec)){
+		still=(uint8_t *)malloc(job.frame_size);
+		if(!still||pattern_fill_buffer(spec,still,pixfmt,width,height)<0){
+			ret=-1;
+			goto end;
+		}
+		job.still=still;
+		if(manifest){
+			if(frame_hash_buffer(still,job.frame_size,&m.hashes[0])<0){
+				ret=-1;
+				goto end;
+			}
+			for(i=1;i<frames;i++)
+				m.hashes[i]=m.hashes[0];
+		}
+		//Nothing to draw, stdout takes the frames one by one anyway
+		if(to_stdout)
+			nb_threads=1;
+	}else if((long long)nb_threads*job.frame_size>WRITER_MAX_BUFFERS){
+		nb_threads=WRITER_MAX_BUFFERS/job.frame_size;
+		if(nb_threads<1)
+			nb_threads=1;
+	}
+
+	job.buffers=(uint8_t **)calloc(nb_threads,sizeof(uint8_t *));
+	job.failed=(int *)calloc(nb_threads,sizeof(int));
+	if(!job.buffers||!job.failed){
+		ret=-1;
+		goto end;
+	}
+	if(to_stdout){
+#ifdef _WIN32
+		_setmode(_fileno(stdout),_O_BINARY);
+#endif
+		job.order=pic_order_alloc();
+		if(!job.order){
+			ret=-1;
+			goto end;
+		}
+	}else{
+#ifdef _WIN32
+		FILE *fp=fopen(path,"wb");
+		if(fp)
+			fclose(fp);
+		job.files=(FILE **)calloc(nb_threads,sizeof(FILE *));
+		if(!fp||!job.files){
+#else
+		//Read too, copy_file_range() copies from the output itself
+		job.fd=open(path,O_RDWR|O_CREAT|O_TRUNC,0644);
+		if(job.fd<0){
+#endif
+			fprintf(log,"Error: Cannot create file %s.\n",path);
+			ret=-1;
+			goto end;
+		}
+	}
+
+#ifdef __linux__
+	if(still&&!to_stdout){
+		int reflinked=0;
+		job.first=replicate_still(&job,frames,&reflinked);
+		if(job.first<0){
+			job.first=frames;
+			ret=-1;
+		}else if(job.first>1){
+			fprintf(log,"Still frame replicated to %d frames %s\n",job.first,
+				reflinked?"as reflinks":"with copy_file_range()");
+		}
+	}
+#endif
+	if(job.first<frames&&parallel_for(frames-job.first,nb_threads,write_frame,&job)<0)
+		ret=-1;
+	for(i=0;i<nb_threads;i++){
+		if(job.failed[i])
+			ret=-1;
+#ifdef _WIN32
+		if(job.files&&job.files[i]&&fclose(job.files[i])!=0)
+			ret=-1;
+#endif
+	}
+	if(to_stdout&&fflush(stdout)!=0)
+		ret=-1;
+#ifndef _WIN32
+	if(!to_stdout&&close(job.fd)!=0)
+		ret=-1;
+#endif
+	if(ret<0){
+		fprintf(log,"Error: Cannot write %s.\n",path);
+		goto end;
+	}
+	elapsed=now_seconds()-start;
+	fprintf(log,"Finish generate %s! %d frames, %.1f MB/s\n",to_stdout?"stdout":path,frames,
+		elapsed>0?(double)frames*job.frame_size/elapsed/(1<<20):0);
+	if(manifest){
+		m.spec=*spec;
+		m.pixfmt=pixfmt;
+		m.width=width;
+		m.height=height;
+		m.frames=frames;
+		if(manifest_write(&m,manifest)<0){
+			fprintf(log,"Error: Cannot write %s.\n",manifest);
+			ret=-1;
+		}
+	}
+
+end:
+	if(job.buffers){
+		for(i=0;i<nb_threads;i++)
+			free(job.buffers[i]);
+	}
+	free(job.buffers);
+	free(job.failed);
+#ifdef _WIN32
+	free(job.files);
+#endif
+	pic_order_free(&job.order);
+	free(still);
+	manifest_free(&m);
+	return ret;
+}
@@ -0,0 +1,41 @@
+/**
+ * Pattern sequences written to raw files or to stdout
+ *
+ * Frames are drawn in parallel, one buffer per thread, and written as soon
+ * as they are ready. Files get positioned writes at frame*frame_size, so
+ * threads never wait for each other. stdout gets the frames in order,
+ * threads only take turns for the write itself. A still pattern is drawn
+ * once and the same buffer is written for every frame; on Linux a file
+ * gets it a few times and the rest is copied within the file, as reflinks
+ * where the file system supports them, so a huge static file takes seconds
+ * and, on copy-on-write file systems, almost no space.
+ *
+ * Each thread also hashes the frames it drew for the manifest (see
+ * pattern_manifest.h), which is written once all frames are.
+ */
+
+#ifndef PATTERN_WRITER_H
+#define PATTERN_WRITER_H
+
+#include "pattern.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Write frames of a pattern. Moving patterns count frames from spec->frame.
+ *
+ * @param path			output file, "-" for stdout.
+ * @param nb_threads	number of threads, <=0 for one per CPU core.
+ * @param manifest		checksum manifest to write, NULL for none.
+ * @return 0 if finished, -1 if there are errors.
+ */
+int pattern_write_sequence(const PatternSpec *spec,const char *path,
+	enum AVPixelFormat pixfmt,int width,int height,int frames,int nb_threads,const char *manifest);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
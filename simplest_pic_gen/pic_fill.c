@@ -0,0 +1,121 @@
+/**
+ * The pictures of main() drawn into buffers
+ */
+
+#include "pic_fill.h"
+
+static const unsigned char colorbar[8][3]={
+	{255,255,255},{255,255,0},{0,255,255},{0,255,0},
+	{255,0,255},{255,0,0},{0,0,255},{0,0,0}
+};
+
+void fill_rgb24_stripe(unsigned char *data,int width,int height,
+	unsigned char r,unsigned char g,unsigned char b){
+
+	int i=0,j=0;
+
+	for(j=0;j<height;j++){
+		for(i=0;i<width;i++){
+			if(i%2!=0){
+				data[(j*width+i)*3+0]=r;
+				data[(j*width+i)*3+1]=g;
+				data[(j*width+i)*3+2]=b;
+			}else{//White
+				data[(j*width+i)*3+0]=255;
+				data[(j*width+i)*3+1]=255;
+				data[(j*width+i)*3+2]=255;
+			}
+		}
+	}
+}
+
+void fill_yuv420p_graybar(unsigned char *data,int width,int height,int barnum,
+	unsigned char ymin,unsigned char ymax){
+
+	int barwidth=width/barnum;
+	float lum_inc=((float)(ymax-ymin))/((float)(barnum-1));
+	int uv_width=width/2,uv_height=height/2;
+	unsigned char *data_y=data;
+	unsigned char *data_u=data_y+width*height;
+	unsigned char *data_v=data_u+uv_width*uv_height;
+	int t=0,i=0,j=0;
+
+	for(j=0;j<height;j++){
+		for(i=0;i<width;i++){
+			t=i/barwidth;
+			data_y[j*width+i]=ymin+(char)(t*lum_inc);
+		}
+	}
+	for(i=0;i<uv_width*uv_height;i++){
+		data_u[i]=128;
+		data_v[i]=128;
+	}
+}
+
+void fill_rgb24_colorbar(unsigned char *data,int width,int height){
+
+	int barwidth=width/8;
+	int i=0,j=0;
+
+	for(j=0;j<height;j++){
+		for(i=0;i<width;i++){
+			int barnum=i/barwidth;
+			//Columns past 8 bars stay as they are
+			if(barnum>7)
+				continue;
+			data[(j*width+i)*3+0]=colorbar[barnum][0];
+			data[(j*width+i)*3+1]=colorbar[barnum][1];
+			data[(j*width+i)*3+2]=colorbar[barnum][2];
+		}
+	}
+}
+
+void fill_rgb24_rgbgradient_bar(unsigned char *data,int width,int height,int barnum,
+	unsigned char src_r,unsigned char src_g,unsigned char src_b,
+	unsigned char dst_r,unsigned char dst_g,unsigned char dst_b){
+
+	int barwidth=width/barnum;
+	float r_inc=((float)(dst_r-src_r))/((float)(barnum-1));
+	float g_inc=((float)(dst_g-src_g))/((float)(barnum-1));
+	float b_inc=((float)(dst_b-src_b))/((float)(barnum-1));
+	int t=0,i=0,j=0;
+
+	for(j=0;j<height;j++){
+		for(i=0;i<width;i++){
+			t=i/barwidth;
+			data[(j*width+i)*3+0]=src_r+(char)(t*r_inc);
+			data[(j*width+i)*3+1]=src_g+(char)(t*g_inc);
+			data[(j*width+i)*3+2]=src_b+(char)(t*b_inc);
+		}
+	}
+}
+
+void fill_yuv420p_yuvgradient_bar(unsigned char *data,int width,int height,int barnum,
+	unsigned char src_y,unsigned char src_u,unsigned char src_v,
+	unsigned char dst_y,unsigned char dst_u,unsigned char dst_v){
+
+	int uv_width=width/2,uv_height=height/2;
+	unsigned char *data_y=data;
+	unsigned char *data_u=data_y+width*height;
+	unsigned char *data_v=data_u+uv_width*uv_height;
+	int barwidth=width/barnum;
+	int uv_barwidth=barwidth/(width/uv_width);
+	float y_inc=((float)(dst_y-src_y))/((float)(barnum-1));
+	float u_inc=((float)(dst_u-src_u))/((float)(barnum-1));
+	float v_inc=((float)(dst_v-src_v))/((float)(barnum-1));
+	int t=0,i=0,j=0;
+
+	for(j=0;j<height;j++){
+		for(i=0;i<width;i++){
+			t=i/barwidth;
+			data_y[j*width+i]=src_y+(char)(t*y_inc);
+		}
+	}
+	for(j=0;j<uv_height;j++){
+		for(i=0;i<uv_width;i++){
+			t=i/uv_barwidth;
+			data_u[j*uv_width+i]=src_u+(char)(t*u_inc);
+			data_v[j*uv_width+i]=src_v+(char)(t*v_inc);
+		}
+	}
+}
@@ -0,0 +1,45 @@
+/**
+ * The pictures of main() drawn into buffers
+ *
+ * Each function fills one raw frame supplied by the caller (planes back to
+ * back, rows not padded), with no files and no messages, so the pictures
+ * can be generated in memory, e.g. as benchmark input. Parameters are not
+ * checked, the gen_*() functions of main() do that.
+ */
+
+#ifndef PIC_FILL_H
+#define PIC_FILL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Bytes of one frame
+#define RGB24_FRAME_SIZE(width,height) ((width)*(height)*3)
+#define YUV420P_FRAME_SIZE(width,height) ((width)*(height)+2*((width)/2)*((height)/2))
+
+//White and r,g,b stripes, 1 pixel wide
+void fill_rgb24_stripe(unsigned char *data,int width,int height,
+	unsigned char r,unsigned char g,unsigned char b);
+
+//barnum gray bars from ymin to ymax
+void fill_yuv420p_graybar(unsigned char *data,int width,int height,int barnum,
+	unsigned char ymin,unsigned char ymax);
+
+//White, yellow, cyan, green, magenta, red, blue, black
+void fill_rgb24_colorbar(unsigned char *data,int width,int height);
+
+//barnum bars from the source to the destination color
+void fill_rgb24_rgbgradient_bar(unsigned char *data,int width,int height,int barnum,
+	unsigned char src_r,unsigned char src_g,unsigned char src_b,
+	unsigned char dst_r,unsigned char dst_g,unsigned char dst_b);
+
+void fill_yuv420p_yuvgradient_bar(unsigned char *data,int width,int height,int barnum,
+	unsigned char src_y,unsigned char src_u,unsigned char src_v,
+	unsigned char dst_y,unsigned char dst_u,unsigned char dst_v);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,223 @@
+/**
+ * Minimal portable parallel loop for the generators
+ */
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "pic_thread.h"
+
+typedef struct ParallelState{
+	ParallelFunc func;
+	void *arg;
+	int nb_items;
+	int next;
+#ifdef _WIN32
+	CRITICAL_SECTION lock;
+#else
+	pthread_mutex_t lock;
+#endif
+}ParallelState;
+
+typedef struct ParallelWorker{
+	ParallelState *state;
+	int idx;
+}ParallelWorker;
+
+int cpu_count(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors>0?(int)info.dwNumberOfProcessors:1;
+#else
+	long n=sysconf(_SC_NPROCESSORS_ONLN);
+	return n>0?(int)n:1;
+#endif
+}
+
+static int next_item(ParallelState *state)
+{
+	int item;
+#ifdef _WIN32
+	EnterCriticalSection(&state->lock);
+	item=state->next++;
+	LeaveCriticalSection(&state->lock);
+#else
+	pthread_mutex_lock(&state->lock);
+	item=state->next++;
+	pthread_mutex_unlock(&state->lock);
+#endif
+	return item;
+}
+
+static void run_worker(ParallelWorker *worker)
+{
+	ParallelState *state=worker->state;
+	int item;
+	while((item=next_item(state))<state->nb_items)
+		state->func(state->arg,item,worker->idx);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker_proc(LPVOID arg)
+{
+	run_worker((ParallelWorker *)arg);
+	return 0;
+}
+#else
+static void *worker_proc(void *arg)
+{
+	run_worker((ParallelWorker *)arg);
+	return NULL;
+}
+#endif
+
+int parallel_for(int nb_items,int nb_threads,ParallelFunc func,void *arg)
+{
+	ParallelState state;
+	ParallelWorker *workers=NULL;
+	int i=0,started=0,ret=0;
+#ifdef _WIN32
+	HANDLE *threads=NULL;
+#else
+	pthread_t *threads=NULL;
+#endif
+
+	if(nb_threads<=0)
+		nb_threads=cpu_count();
+	if(nb_threads>nb_items)
+		nb_threads=nb_items>0?nb_items:1;
+	state.func=func;
+	state.arg=arg;
+	state.nb_items=nb_items;
+	state.next=0;
+
+	workers=(ParallelWorker *)malloc(nb_threads*sizeof(ParallelWorker));
+#ifdef _WIN32
+	threads=(HANDLE *)malloc(nb_threads*sizeof(HANDLE));
+	InitializeCriticalSection(&state.lock);
+#else
+	threads=(pthread_t *)malloc(nb_threads*sizeof(pthread_t));
+	pthread_mutex_init(&state.lock,NULL);
+#endif
+	if(!workers||!threads){
+		ret=-1;
+		goto end;
+	}
+
+	//The calling thread is worker 0
+	for(i=1;i<nb_threads;i++){
+		workers[i].state=&state;
+		workers[i].idx=i;
+#ifdef _WIN32
+		threads[i]=CreateThread(NULL,0,worker_proc,&workers[i],0,NULL);
+		if(!threads[i])
+			break;
+#else
+		if(pthread_create(&threads[i],NULL,worker_proc,&workers[i])!=0)
+			break;
+#endif
+		started++;
+	}
+	workers[0].state=&state;
+	workers[0].idx=0;
+	run_worker(&workers[0]);
+	for(i=1;i<=started;i++){
+#ifdef _WIN32
+		WaitForSingleObject(threads[i],INFINITE);
+		CloseHandle(threads[i]);
+#else
+		pthread_join(threads[i],NULL);
+#endif
+	}
+
+end:
+#ifdef _WIN32
+	DeleteCriticalSection(&state.lock);
+#else
+	pthread_mutex_destroy(&state.lock);
+#endif
+	free(workers);
+	free(threads);
+	return ret;
+}
+
+struct PicOrder{
+	int next;                   //item whose turn it is
+#ifdef _WIN32
+	CRITICAL_SECTION lock;
+	CONDITION_VARIABLE cond;
+#else
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+#endif
+};
+
+PicOrder *pic_order_alloc(void)
+{
+	PicOrder *order=(PicOrder *)malloc(sizeof(PicOrder));
+	if(!order)
+		return NULL;
+	order->next=0;
+#ifdef _WIN32
+	InitializeCriticalSection(&order->lock);
+	InitializeConditionVariable(&order->cond);
+#else
+	pthread_mutex_init(&order->lock,NULL);
+	pthread_cond_init(&order->cond,NULL);
+#endif
+	return order;
+}
+
+void pic_order_free(PicOrder **order)
+{
+	if(!*order)
+		return;
+#ifdef _WIN32
+	DeleteCriticalSection(&(*order)->lock);
+#else
+	pthread_mutex_destroy(&(*order)->lock);
+	pthread_cond_destroy(&(*order)->cond);
+#endif
+	free(*order);
+	*order=NULL;
+}
+
+//Items are handed out in order, so the ones before are already running
+//and the wait always ends
+void pic_order_wait(PicOrder *order,int item)
+{
+#ifdef _WIN32
+	EnterCriticalSection(&order->lock);
+	while(order->next!=item)
+		SleepConditionVariableCS(&order->cond,&order->lock,INFINITE);
+	LeaveCriticalSection(&order->lock);
+#else
+	pthread_mutex_lock(&order->lock);
+	while(order->next!=item)
+		pthread_cond_wait(&order->cond,&order->lock);
+	pthread_mutex_unlock(&order->lock);
+#endif
+}
+
+void pic_order_done(PicOrder *order,int item)
+{
+#ifdef _WIN32
+	EnterCriticalSection(&order->lock);
+	order->next=item+1;
+	LeaveCriticalSection(&order->lock);
+	WakeAllConditionVariable(&order->cond);
+#else
+	pthread_mutex_lock(&order->lock);
+	order->next=item+1;
+	pthread_cond_broadcast(&order->cond);
+	pthread_mutex_unlock(&order->lock);
+#endif
+}
@@ -0,0 +1,43 @@
+/**
+ * Minimal portable parallel loop for the generators
+ *
+ * Win32 threads on Windows, pthreads elsewhere.
+ */
+
+#ifndef PIC_THREAD_H
+#define PIC_THREAD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//Called once per item. worker is in [0,nb_threads), for per-thread state.
+typedef void (*ParallelFunc)(void *arg,int item,int worker);
+
+//Number of online CPU cores, at least 1
+int cpu_count(void);
+
+/**
+ * Run func for every item in [0,nb_items) on nb_threads threads. Items
+ * are handed out in increasing order as threads become free.
+ *
+ * @param nb_threads	number of threads, <=0 for one per CPU core.
+ * @return 0 if finished, -1 if the threads could not be started.
+ */
+int parallel_for(int nb_items,int nb_threads,ParallelFunc func,void *arg);
+
+//Lets the items of a parallel_for() take turns in item order, e.g. to write
+//their results to a stream. Every item must call pic_order_done() once.
+typedef struct PicOrder PicOrder;
+
+PicOrder *pic_order_alloc(void);
+void pic_order_free(PicOrder **order);
+//Block until every item before this one has called pic_order_done()
+void pic_order_wait(PicOrder *order,int item);
+void pic_order_done(PicOrder *order,int item);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -29,6 +29,25 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "bmp_export.h"
+#include "pic_fill.h"
+#include "pattern_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#ifdef _WIN32
+//Windows
+#include "libavutil/pixdesc.h"
+#else
+//Linux...
+#include <libavutil/pixdesc.h>
+#endif
+#ifdef __cplusplus
+}
+#endif
 
 
 /**
@@ -47,7 +66,6 @@ int gen_rgb24_stripe(int width, int height,
 	unsigned char *data=NULL;
 	char filename[100]={0};
 	FILE *fp=NULL;
-	int i=0,j=0;
 
 	//Check
 	if(width<=0||height<=0){
@@ -57,7 +75,7 @@ int gen_rgb24_stripe(int width, int height,
 		height=480;
 	}
 
-	data=(unsigned char *)malloc(width*height*3);
+	data=(unsigned char *)malloc(RGB24_FRAME_SIZE(width,height));
 
 	sprintf(filename,"rgbstripe_%dx%d_rgb24.rgb",width,height);
 	if((fp=fopen(filename,"wb+"))==NULL){
@@ -65,19 +83,7 @@ int gen_rgb24_stripe(int width, int height,
 		return -1;
 	}
 
-	for(j=0;j<height;j++){
-		for(i=0;i<width;i++){
-			if(i%2!=0){
-				data[(j*width+i)*3+0]=r;
-				data[(j*width+i)*3+1]=g;
-				data[(j*width+i)*3+2]=b;
-			}else{//White
-				data[(j*width+i)*3+0]=255;
-				data[(j*width+i)*3+1]=255;
-				data[(j*width+i)*3+2]=255;
-			}
-		}
-	}
+	fill_rgb24_stripe(data,width,height,r,g,b);
 	fwrite(data,width*height*3,1,fp);
 	fclose(fp);
 	free(data);
@@ -101,12 +107,9 @@ int gen_yuv420p_graybar(int width, int height,int barnum,unsigned char ymin,unsi
 	int barwidth;
 	float lum_inc;
 	unsigned char lum_temp;
-	int uv_width,uv_height;
 	FILE *fp=NULL;
-	unsigned char *data_y=NULL;
-	unsigned char *data_u=NULL;
-	unsigned char *data_v=NULL;
-	int t=0,i=0,j=0;
+	unsigned char *data=NULL;
+	int t=0;
 	char filename[100]={0};
 
 	//Check
@@ -122,12 +125,8 @@ int gen_yuv420p_graybar(int width, int height,int barnum,unsigned char ymin,unsi
 	}
 	barwidth=width/barnum;
 	lum_inc=((float)(ymax-ymin))/((float)(barnum-1));
-	uv_width=width/2;
-	uv_height=height/2;
 
-	data_y=(unsigned char *)malloc(width*height);
-	data_u=(unsigned char *)malloc(uv_width*uv_height);
-	data_v=(unsigned char *)malloc(uv_width*uv_height);
+	data=(unsigned char *)malloc(YUV420P_FRAME_SIZE(width,height));
 
 	sprintf(filename,"graybar_%dx%d_yuv420p.yuv",width,height);
 	if((fp=fopen(filename,"wb+"))==NULL){
@@ -142,30 +141,10 @@ int gen_yuv420p_graybar(int width, int height,int barnum,unsigned char ymin,unsi
 		printf("%3d, 128, 128\n",lum_temp);
 	}
 	//Gen Data
-	for(j=0;j<height;j++){
-		for(i=0;i<width;i++){
-			t=i/barwidth;
-			lum_temp=ymin+(char)(t*lum_inc);
-			data_y[j*width+i]=lum_temp;
-		}
-	}
-	for(j=0;j<uv_height;j++){
-		for(i=0;i<uv_width;i++){
-			data_u[j*uv_width+i]=128;
-		}
-	}
-	for(j=0;j<uv_height;j++){
-		for(i=0;i<uv_width;i++){
-			data_v[j*uv_width+i]=128;
-		}
-	}
-	fwrite(data_y,width*height,1,fp);
-	fwrite(data_u,uv_width*uv_height,1,fp);
-	fwrite(data_v,uv_width*uv_height,1,fp);
+	fill_yuv420p_graybar(data,width,height,barnum,ymin,ymax);
+	fwrite(data,YUV420P_FRAME_SIZE(width,height),1,fp);
 	fclose(fp);
-	free(data_y);
-	free(data_u);
-	free(data_v);
+	free(data);
 	printf("Finish generate %s!\n",filename);
     return 0;
 }
@@ -180,10 +159,8 @@ int gen_yuv420p_graybar(int width, int height,int barnum,unsigned char ymin,unsi
 int gen_rgb24_colorbar(int width, int height){
 	
 	unsigned char *data=NULL;
-	int barwidth;
 	char filename[100]={0};
 	FILE *fp=NULL;
-	int i=0,j=0;
 	int lum;
 	float r_coeff=0.299,g_coeff=0.587,b_coeff=0.114;
 
@@ -198,7 +175,6 @@ int gen_rgb24_colorbar(int width, int height){
 		printf("Warning: Width cannot be divided by Bar Number without remainder!\n");
 
 	data=(unsigned char *)malloc(width*height*3);
-	barwidth=width/8;
 
 	sprintf(filename,"colorbar_%dx%d_rgb24.rgb",width,height);
 	if((fp=fopen(filename,"wb+"))==NULL){
@@ -232,63 +208,7 @@ int gen_rgb24_colorbar(int width, int height){
 	printf("[Black]  \tR,G,B=  0,  0,  0\t Y=%.3f*R+%.3f*G+%.3f*B=%3d\n",
 		r_coeff,g_coeff,b_coeff,lum);
 
-	for(j=0;j<height;j++){
-		for(i=0;i<width;i++){
-			int barnum=i/barwidth;
-			switch(barnum){
-			case 0:{
-				data[(j*width+i)*3+0]=255;
-				data[(j*width+i)*3+1]=255;
-				data[(j*width+i)*3+2]=255;
-				break;
-				   }
-			case 1:{
-				data[(j*width+i)*3+0]=255;
-				data[(j*width+i)*3+1]=255;
-				data[(j*width+i)*3+2]=0;
-				break;
-				   }
-			case 2:{
-				data[(j*width+i)*3+0]=0;
-				data[(j*width+i)*3+1]=255;
-				data[(j*width+i)*3+2]=255;
-				break;
-				   }
-			case 3:{
-				data[(j*width+i)*3+0]=0;
-				data[(j*width+i)*3+1]=255;
-				data[(j*width+i)*3+2]=0;
-				break;
-				   }
-			case 4:{
-				data[(j*width+i)*3+0]=255;
-				data[(j*width+i)*3+1]=0;
-				data[(j*width+i)*3+2]=255;
-				break;
-				   }
-			case 5:{
-				data[(j*width+i)*3+0]=255;
-				data[(j*width+i)*3+1]=0;
-				data[(j*width+i)*3+2]=0;
-				break;
-				   }
-			case 6:{
-				data[(j*width+i)*3+0]=0;
-				data[(j*width+i)*3+1]=0;
-				data[(j*width+i)*3+2]=255;
-				
-				break;
-				   }
-			case 7:{
-				data[(j*width+i)*3+0]=0;
-				data[(j*width+i)*3+1]=0;
-				data[(j*width+i)*3+2]=0;
-				break;
-				   }
-			}
-
-		}
-	}
+	fill_rgb24_colorbar(data,width,height);
 	fwrite(data,width*height*3,1,fp);
 	fclose(fp);
 	free(data);
@@ -321,7 +241,7 @@ int gen_rgb24_rgbgradient_bar(int width, int height,int barnum,
 	unsigned char r_temp,g_temp,b_temp;
 	char filename[100]={0};
 	FILE *fp=NULL;
-	int t=0,i=0,j=0;
+	int t=0;
 
 	//Check
 	if(width<=0||height<=0||barnum<=0){
@@ -355,17 +275,7 @@ int gen_rgb24_rgbgradient_bar(int width, int height,int barnum,
 		printf("%3d, %3d, %3d\n",r_temp,g_temp,b_temp);
 	}
 
-	for(j=0;j<height;j++){
-		for(i=0;i<width;i++){
-			t=i/barwidth;
-			r_temp=src_r+(char)(t*r_inc);
-			g_temp=src_g+(char)(t*g_inc);
-			b_temp=src_b+(char)(t*b_inc);
-			data[(j*width+i)*3+0]=r_temp;
-			data[(j*width+i)*3+1]=g_temp;
-			data[(j*width+i)*3+2]=b_temp;
-		}
-	}
+	fill_rgb24_rgbgradient_bar(data,width,height,barnum,src_r,src_g,src_b,dst_r,dst_g,dst_b);
 	fwrite(data,width*height*3,1,fp);
 	fclose(fp);
 	free(data);
@@ -392,16 +302,13 @@ int gen_yuv420p_yuvgradient_bar(int width, int height,int barnum,
 	unsigned char src_y,unsigned char src_u,unsigned char src_v,
 	unsigned char dst_y,unsigned char dst_u,unsigned char dst_v){
 
-	int uv_width,uv_height;
-	unsigned char *data_y=NULL;
-	unsigned char *data_u=NULL;
-	unsigned char *data_v=NULL;
+	unsigned char *data=NULL;
 	FILE *fp=NULL;
-	int barwidth,uv_barwidth;
+	int barwidth;
 	float y_inc,u_inc,v_inc=0;
 	unsigned char y_temp,u_temp,v_temp=0;
 	char filename[100]={0};
-	int t=0,i=0,j=0;
+	int t=0;
 	//Check
 	if(width<=0||height<=0||barnum<=0){
 		printf("Error: Width, Height or Bar Number cannot be 0 or negative number!\n");
@@ -412,13 +319,8 @@ int gen_yuv420p_yuvgradient_bar(int width, int height,int barnum,
 	if(width%barnum!=0)
 		printf("Warning: Width cannot be divided by Bar Number without remainder!\n");
 
-	uv_width=width/2;
-	uv_height=height/2;
-	data_y=(unsigned char *)malloc(width*height);
-	data_u=(unsigned char *)malloc(uv_width*uv_height);
-	data_v=(unsigned char *)malloc(uv_width*uv_height);
+	data=(unsigned char *)malloc(YUV420P_FRAME_SIZE(width,height));
 	barwidth=width/barnum;
-	uv_barwidth=barwidth/(width/uv_width);
 	y_inc=((float)(dst_y-src_y))/((float)(barnum-1));
 	u_inc=((float)(dst_u-src_u))/((float)(barnum-1));
 	v_inc=((float)(dst_v-src_v))/((float)(barnum-1));
@@ -439,34 +341,10 @@ int gen_yuv420p_yuvgradient_bar(int width, int height,int barnum,
 	}
 
 	//Gen Data
-	for(j=0;j<height;j++){
-		for(i=0;i<width;i++){
-			t=i/barwidth;
-			y_temp=src_y+(char)(t*y_inc);
-			data_y[j*width+i]=y_temp;
-		}
-	}
-	for(j=0;j<uv_height;j++){
-		for(i=0;i<uv_width;i++){
-			t=i/uv_barwidth;
-			u_temp=src_u+(char)(t*u_inc);
-			data_u[j*uv_width+i]=u_temp;
-		}
-	}
-	for(j=0;j<uv_height;j++){
-		for(i=0;i<uv_width;i++){
-			t=i/uv_barwidth;
-			v_temp=src_v+(char)(t*v_inc);
-			data_v[j*uv_width+i]=v_temp;
-		}
-	}
-	fwrite(data_y,width*height,1,fp);
-	fwrite(data_u,uv_width*uv_height,1,fp);
-	fwrite(data_v,uv_width*uv_height,1,fp);
+	fill_yuv420p_yuvgradient_bar(data,width,height,barnum,src_y,src_u,src_v,dst_y,dst_u,dst_v);
+	fwrite(data,YUV420P_FRAME_SIZE(width,height),1,fp);
 	fclose(fp);
-	free(data_y);
-	free(data_u);
-	free(data_v);
+	free(data);
 	printf("Finish generate %s!\n",filename);
 	return 0;
 }
@@ -482,34 +360,11 @@ int gen_yuv420p_yuvgradient_bar(int width, int height,int barnum,
  */
 int rgb24_to_bmp(const char *rgb24path,const char *bmppath,int width,int height)
 {
-	typedef struct 
-	{  
-		long imageSize;
-		long blank;
-		long startPosition;
-	}BmpHead;
-
-	typedef struct
-	{
-		long  Length;
-		long  width;
-		long  height;
-		unsigned short  colorPlane;
-		unsigned short  bitColor;
-		long  zipFormat;
-		long  realSize;
-		long  xPels;
-		long  yPels;
-		long  colorUse;
-		long  colorImportant;
-	}InfoHead;
-	
-	int i=0,j=0;
-	BmpHead m_BMPHeader={0};
-	InfoHead  m_BMPInfoHeader={0};
-	char bfType[2]={'B','M'};
-	int header_size=sizeof(bfType)+sizeof(BmpHead)+sizeof(InfoHead);
+	unsigned char header[BMP_HEADER_SIZE];
+	int row_size=bmp_row_size(width);
+	int j=0;
 	unsigned char *rgb24_buffer=NULL;
+	unsigned char *bmp_row=NULL;
 	FILE *fp_rgb24=NULL,*fp_bmp=NULL;
 	
 	if((fp_rgb24=fopen(rgb24path,"rb"))==NULL){
@@ -518,41 +373,35 @@ int rgb24_to_bmp(const char *rgb24path,const char *bmppath,int width,int height)
 	}
 	if((fp_bmp=fopen(bmppath,"wb"))==NULL){
 		printf("Error: Cannot open output BMP file.\n");
+		fclose(fp_rgb24);
 		return -1;
 	}
 	
 	rgb24_buffer=(unsigned char *)malloc(width*height*3);
-	fread(rgb24_buffer,1,width*height*3,fp_rgb24);
-
-	m_BMPHeader.imageSize=3*width*height+header_size;
-	m_BMPHeader.startPosition=header_size;
-
-	m_BMPInfoHeader.Length=sizeof(InfoHead); 
-	m_BMPInfoHeader.width=width;
-	//BMP storage pixel data in opposite direction of Y-axis (from bottom to top).
-	m_BMPInfoHeader.height=-height;
-	m_BMPInfoHeader.colorPlane=1;
-	m_BMPInfoHeader.bitColor=24;
-	m_BMPInfoHeader.realSize=3*width*height;
+	bmp_row=(unsigned char *)malloc(row_size);
+	if(fread(rgb24_buffer,1,width*height*3,fp_rgb24)!=(size_t)(width*height*3)){
+		printf("Error: Cannot read input RGB24 file.\n");
+		fclose(fp_rgb24);
+		fclose(fp_bmp);
+		free(rgb24_buffer);
+		free(bmp_row);
+		return -1;
+	}
 
-	fwrite(bfType,1,sizeof(bfType),fp_bmp);
-	fwrite(&m_BMPHeader,1,sizeof(m_BMPHeader),fp_bmp);
-	fwrite(&m_BMPInfoHeader,1,sizeof(m_BMPInfoHeader),fp_bmp);
+	bmp_write_header(header,width,height);
+	fwrite(header,1,BMP_HEADER_SIZE,fp_bmp);
 
 	//BMP save R1|G1|B1,R2|G2|B2 as B1|G1|R1,B2|G2|R2
 	//It saves pixel data in Little Endian
-	//So we change 'R' and 'B'
-	for(j =0;j<height;j++){
-		for(i=0;i<width;i++){
-			char temp=rgb24_buffer[(j*width+i)*3+2];
-			rgb24_buffer[(j*width+i)*3+2]=rgb24_buffer[(j*width+i)*3+0];
-			rgb24_buffer[(j*width+i)*3+0]=temp;
-		}
+	//So we change 'R' and 'B', and pad each row to 4 bytes
+	for(j=0;j<height;j++){
+		bmp_convert_row(rgb24_buffer+j*width*3,bmp_row,width,0);
+		fwrite(bmp_row,1,row_size,fp_bmp);
 	}
-	fwrite(rgb24_buffer,3*width*height,1,fp_bmp);
 	fclose(fp_rgb24);
 	fclose(fp_bmp);
 	free(rgb24_buffer);
+	free(bmp_row);
 	printf("Finish generate %s!\n",bmppath);
 	return 0;
 }
@@ -578,69 +427,29 @@ int rgb24_to_bmp(const char *rgb24path,const char *bmppath,int width,int height)
  */
 int gen_allcolor_video(){
 
-	unsigned char *data=NULL;
+	PatternSpec spec;
 	char filename[100]={0};
-	FILE *fp=NULL;
+	char manifest[120]={0};
 	int width=256,height=256,frames=256;
-	int i=0,j=0,k=0;
+
+	//Frames are drawn in parallel and written as they are ready
+	pattern_preset(&spec,"allcolor");
 
 	//From left to right (width, X-axis),R increasing from 0 to255 
 	//From Top to bottom (height, Y-axis),G increasing from 0 to255 
 	//From 0 to 255 frames (time, Z-axis),B increasing from 0 to255 
-	data=(unsigned char *)malloc(width*height*3);
 	sprintf(filename,"allcolor_xr_yg_zb_%dx%d_rgb24.rgb",width,height);
-	if((fp=fopen(filename,"wb+"))==NULL){
-		printf("Error: Cannot create file!");
+	sprintf(manifest,"%s.manifest",filename);
+	if(pattern_write_sequence(&spec,filename,AV_PIX_FMT_RGB24,width,height,frames,0,manifest)<0)
 		return -1;
-	}
-	for(k=0;k<frames;k++){
-		for(j=0;j<height;j++){
-			for(i=0;i<width;i++){
-				data[(j*width+i)*3+0]=i;
-				data[(j*width+i)*3+1]=j;
-				data[(j*width+i)*3+2]=k;
-			}
-		}
-		fwrite(data,width*height*3,1,fp);
-		printf("Finish generate frame %d!\n",k);
-	}
-	fclose(fp);
-	free(data);
-	printf("Finish generate %s!\n",filename);
 
 	//From left to right (width, X-axis),U increasing from 0 to255 
 	//From Top to bottom (height, Y-axis),V increasing from 0 to255 
 	//From 0 to 255 frames (time, Z-axis),Y increasing from 0 to255 
-	data=(unsigned char *)malloc(width*height);
 	sprintf(filename,"allcolor_xu_yv_zy_%dx%d_yuv444p.yuv",width,height);
-	if((fp=fopen(filename,"wb+"))==NULL){
-		printf("Error: Cannot create file!");
+	sprintf(manifest,"%s.manifest",filename);
+	if(pattern_write_sequence(&spec,filename,AV_PIX_FMT_YUV444P,width,height,frames,0,manifest)<0)
 		return -1;
-	}
-	for(k=0;k<frames;k++){
-		for(j=0;j<height;j++){//Y
-			for(i=0;i<width;i++){
-				data[j*width+i]=k;
-			}
-		}
-		fwrite(data,width*height,1,fp);
-		for(j=0;j<height;j++){//U
-			for(i=0;i<width;i++){
-				data[j*width+i]=i;
-			}
-		}
-		fwrite(data,width*height,1,fp);
-		for(j=0;j<height;j++){//V
-			for(i=0;i<width;i++){
-				data[j*width+i]=j;
-			}
-		}
-		fwrite(data,width*height,1,fp);
-		printf("Finish generate frame %d!\n",k);
-	}
-	fclose(fp);
-	free(data);
-	printf("Finish generate %s!\n",filename);
 
 	return 0;
 }
@@ -651,6 +460,45 @@ int gen_allcolor_video(){
 
 int main(int argc, char* argv[])
 {
+	//BMP sequence: simplest_pic_gen -bmp input.rgb width height out_%05d.bmp [rgb24|bgr24] [threads]
+	if(argc>5&&strcmp(argv[1],"-bmp")==0){
+		int bgr=argc>6&&strcmp(argv[6],"bgr24")==0;
+		int threads=argc>7?atoi(argv[7]):0;
+		return raw_to_bmp_sequence(argv[2],argv[5],atoi(argv[3]),atoi(argv[4]),bgr,threads)<0?-1:0;
+	}
+
+	//Pattern in any format: simplest_pic_gen -pattern name pixfmt width height output [frames [threads [seed]]]
+	//output "-" is stdout, a file gets the checksums of its frames in output.manifest
+	//name: colorbar, graybar, rgbgradient, yuvgradient, stripe, allcolor, ramp,
+	//moving: zoneplate, movingbars, rotatingbars, scrolltext, noise
+	//pixfmt may be 9 to 16 bits, e.g. yuv420p10le, yuv422p12be, rgb48le
+	if(argc>6&&strcmp(argv[1],"-pattern")==0){
+		PatternSpec spec;
+		enum AVPixelFormat pixfmt=av_get_pix_fmt(argv[3]);
+		char *manifest=NULL;
+		int ret=0;
+		if(pattern_preset(&spec,argv[2])<0){
+			printf("Error: Unknown pattern %s.\n",argv[2]);
+			return -1;
+		}
+		if(pattern_check_pixfmt(pixfmt)<0){
+			printf("Error: Unsupported pixel format %s.\n",argv[3]);
+			return -1;
+		}
+		if(argc>9)
+			spec.seed=(unsigned int)strtoul(argv[9],NULL,0);
+		if(strcmp(argv[6],"-")!=0){
+			manifest=(char *)malloc(strlen(argv[6])+10);
+			if(!manifest)
+				return -1;
+			sprintf(manifest,"%s.manifest",argv[6]);
+		}
+		ret=pattern_write_sequence(&spec,argv[6],pixfmt,atoi(argv[4]),atoi(argv[5]),
+			argc>7?atoi(argv[7]):1,argc>8?atoi(argv[8]):0,manifest);
+		free(manifest);
+		return ret<0?-1:0;
+	}
+
 	//All picture's resolution is 1280x720
 	//Gray Bar, from 16 to 235
 	gen_yuv420p_graybar(1280,720,10,16,235);